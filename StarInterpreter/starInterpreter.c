@@ -1,572 +1,3500 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <ctype.h>
-#include <stdbool.h>
-
-// Define maximum sizes and other constants
-#define MAX_IDENTIFIER_LENGTH 10
-#define MAX_INTEGER_LENGTH 8
-#define MAX_STRING_LENGTH 256
-#define MAX_VARIABLES 100
-#define MAX_TOKEN_LENGTH 256
-
-// Define token types
-enum TokenType {
-    Identifier,
-    IntConst,
-    Operator,
-    String,
-    Keyword,
-    EndOfLine,
-    Comma,
-    LeftCurlyBracket,
-    RightCurlyBracket,
-    Terminator
-};
-
-// Define data types for variables
-enum VarType {
-    Integer,
-    Text
-};
-
-// Token structure
-typedef struct {
-    enum TokenType type;
-    char value[MAX_STRING_LENGTH];
-} Token;
-
-// Variable structure
-typedef struct {
-    char name[MAX_IDENTIFIER_LENGTH + 1];
-    enum VarType type;
-    union {
-        int intValue;
-        char strValue[MAX_STRING_LENGTH];
-    } value;
-} Variable;
-
-// Function prototypes
-char* read_source_code(const char* filepath);
-Token* tokenize_source_code(const char* source_code);
-void write_tokens_to_file(Token* tokens, const char* filename);
-void interpret(Token* tokens);
-Variable* find_variable(const char* name);
-void declare_variable(const char* name, enum VarType type);
-void assign_variable(const char* name, const char* value);
-void execute_statement(Token** tokens);
-void handle_read(Token** tokens);
-void handle_write(Token** tokens);
-void handle_loop(Token** tokens);
-
-// Global variable storage
-Variable variables[MAX_VARIABLES];
-int var_count = 0;
-
-int main() {
-    const char* source_code_file = "code.sta";
-    char* source_code = read_source_code(source_code_file);
-    Token* tokens = tokenize_source_code(source_code);
-    interpret(tokens);
-
-    free(source_code);
-    free(tokens);
-    return 0;
-}
-
-// Function to read source code from file
-char* read_source_code(const char* filepath) {
-    FILE* file = fopen(filepath, "r");
-    if (file == NULL) {
-        perror("Error opening file");
-        exit(EXIT_FAILURE);
-    }
-
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    rewind(file);
-
-    char* source_code = (char*)malloc((file_size + 1) * sizeof(char));
-    if (source_code == NULL) {
-        perror("Memory allocation error");
-        exit(EXIT_FAILURE);
-    }
-
-    fread(source_code, sizeof(char), file_size, file);
-    source_code[file_size] = '\0';
-
-    fclose(file);
-
-    return source_code;
-}
-
-// Function to check if a character is a valid identifier character
-int is_valid_identifier_char(char ch) {
-    return isalnum(ch) || ch == '_';
-}
-
-// Function to tokenize source code
-Token* tokenize_source_code(const char* source_code) {
-    Token* tokens = (Token*)malloc(MAX_STRING_LENGTH * sizeof(Token));
-    if (tokens == NULL) {
-        perror("Memory allocation error");
-        exit(EXIT_FAILURE);
-    }
-
-    int num_tokens = 0;
-    const char* ptr = source_code;
-    bool in_comment = false; // Flag to track if we are inside a comment
-
-    while (*ptr != '\0') {
-        if (isspace(*ptr)) {
-            ptr++;
-            continue; // Skip whitespace
-        }
-
-        // Comments
-        if (*ptr == '/' && *(ptr + 1) == '*') {
-            in_comment = true; // Set the flag to true to mark start of comment
-            ptr += 2; // Skip the opening comment characters
-            continue; // Continue to the next character
-        }
-
-        // If we are inside a comment, skip characters until we find the end of the comment
-        if (in_comment) {
-            while (*ptr != '*' || *(ptr + 1) != '/') {
-                if (*ptr == '\0') {
-                    // If the comment doesn't terminate before the end of the file, lexical error
-                    fprintf(stderr, "Lexical error: Unterminated comment\n");
-                    exit(EXIT_FAILURE);
-                }
-                ptr++;
-            }
-            ptr += 2; // Skip the closing comment characters
-            in_comment = false; // Reset the flag as we've reached the end of the comment
-            continue; // Continue to the next character
-        }
-
-        // Keywords and Identifiers
-        if (isalpha(*ptr)) {
-            int i = 0;
-            char keyword[MAX_IDENTIFIER_LENGTH + 1];
-            char identifier[MAX_IDENTIFIER_LENGTH + 1]; // Maximum length + 1 for null terminator
-
-            while ((isalpha(*ptr) || *ptr == '_') && i < MAX_IDENTIFIER_LENGTH) {
-                keyword[i++] = *ptr++;
-            }
-            keyword[i] = '\0';
-
-            // Check if the word is a keyword
-            if (strcmp(keyword, "int") == 0 || strcmp(keyword, "text") == 0 ||
-                strcmp(keyword, "is") == 0 || strcmp(keyword, "loop") == 0 ||
-                strcmp(keyword, "times") == 0 || strcmp(keyword, "read") == 0 ||
-                strcmp(keyword, "write") == 0 || strcmp(keyword, "newLine") == 0) {
-                tokens[num_tokens].type = Keyword;
-                strcpy(tokens[num_tokens].value, keyword);
-                num_tokens++;
-            } else {
-                if (isalpha(*ptr) || *ptr == '_') {
-                    fprintf(stderr, "Lexical error: Identifier exceeds maximum length\n");
-                    exit(EXIT_FAILURE);
-                } else {
-                    tokens[num_tokens].type = Identifier;
-                    strcpy(tokens[num_tokens].value, keyword);
-                    num_tokens++;
-                }
-            }
-        }
-
-        // Integer constant
-        else if (isdigit(*ptr) || (*ptr == '-' && isdigit(*(ptr + 1)))) {
-            int i = 0;
-            if (*ptr == '-') {
-                tokens[num_tokens].value[i++] = *ptr++; // Include the minus sign
-            }
-            while (isdigit(*ptr) && i < MAX_INTEGER_LENGTH + 1) {
-                tokens[num_tokens].value[i++] = *ptr++;
-            }
-
-            if (i > MAX_INTEGER_LENGTH) {
-                fprintf(stderr, "Lexical error: Integer constant exceeds maximum length\n");
-                exit(EXIT_FAILURE);
-            }
-
-            tokens[num_tokens].value[i] = '\0';
-            int value = atoi(tokens[num_tokens].value);
-            if (value < 0) {
-                value = 0;
-                fprintf(stderr, "Lexical warning: Integer constant forced to zero\n");
-            }
-            sprintf(tokens[num_tokens].value, "%d", value);
-            tokens[num_tokens++].type = IntConst;
-        }
-
-        // String constants
-        else if (*ptr == '"') {
-            int i = 0;
-            *ptr++;
-            while (*ptr != '"' && *ptr != '\0' && i < MAX_STRING_LENGTH) {
-                tokens[num_tokens].value[i++] = *ptr++;
-            }
-            if (*ptr == '"') {
-                *ptr++;
-            }
-            tokens[num_tokens].value[i] = '\0';
-            tokens[num_tokens].type = String;
-
-            if (i >= MAX_STRING_LENGTH) {
-                fprintf(stderr, "Lexical error: String constant exceeds maximum length\n");
-                exit(EXIT_FAILURE);
-            }
-
-            if (*ptr == '\0') {
-                fprintf(stderr, "Lexical error: Unterminated string constant\n");
-                exit(EXIT_FAILURE);
-            }
-            num_tokens++;
-        }
-
-        // End of line
-        else if (*ptr == '.') {
-            tokens[num_tokens++].type = EndOfLine;
-            ptr++;
-        }
-
-        // Comma
-        else if (*ptr == ',') {
-            tokens[num_tokens++].type = Comma;
-            ptr++;
-        }
-
-        // Operator tokens
-        else if (*ptr == '+' || *ptr == '-' || *ptr == '*') {
-            tokens[num_tokens].type = Operator;
-            tokens[num_tokens].value[0] = *ptr;
-            tokens[num_tokens].value[1] = '\0';
-            num_tokens++;
-            ptr++;
-        }
-
-        // Brackets
-        else if (*ptr == '{') {
-            tokens[num_tokens++].type = LeftCurlyBracket;
-            ptr++;
-        }
-        else if (*ptr == '}') {
-            tokens[num_tokens++].type = RightCurlyBracket;
-            ptr++;
-        }
-
-        // Move to next character
-        else {
-            ptr++;
-        }
-    }
-
-    // Add terminator token
-    tokens[num_tokens].type = Terminator;
-    strcpy(tokens[num_tokens].value, "");
-
-    return tokens;
-}
-
-// Function to interpret tokens
-void interpret(Token* tokens) {
-    Token* current_token = tokens;
-
-    while (current_token->type != Terminator) {
-        execute_statement(&current_token);
-    }
-}
-
-void assign_variable(const char* name, const char* value) {
-    Variable* var = find_variable(name);
-    if (var == NULL) {
-        fprintf(stderr, "Error: Variable %s not declared.\n", name);
-        exit(EXIT_FAILURE);
-    }
-
-    // Check if the value contains an arithmetic expression
-    if (strchr(value, '+') || strchr(value, '-')) {
-        char var_value[MAX_STRING_LENGTH];
-        int result = evaluate_expression(value); // Implement evaluate_expression function
-        if (result < 0) result = 0;
-        sprintf(var_value, "%d", result);
-        if (var->type == Integer) {
-            var->value.intValue = result;
-        } else {
-            strncpy(var->value.strValue, var_value, MAX_STRING_LENGTH);
-            var->value.strValue[MAX_STRING_LENGTH - 1] = '\0';
-        }
-    } else {
-        if (var->type == Integer) {
-            var->value.intValue = atoi(value);
-            if (var->value.intValue < 0) {
-                var->value.intValue = 0;
-                fprintf(stderr, "Warning: Negative value forced to zero for variable %s.\n", name);
-            }
-        } else {
-            strncpy(var->value.strValue, value, MAX_STRING_LENGTH);
-            var->value.strValue[MAX_STRING_LENGTH - 1] = '\0';
-        }
-    }
-}
-
-
-void execute_statement(Token** tokens) {
-    Token* current_token = *tokens;
-
-    // Handle variable declarations and assignments
-    if (current_token->type == Keyword && (strcmp(current_token->value, "int") == 0 || strcmp(current_token->value, "text") == 0)) {
-        enum VarType var_type = (strcmp(current_token->value, "int") == 0) ? Integer : Text;
-        current_token++;
-        while (current_token->type == Identifier) {
-            char var_name[MAX_IDENTIFIER_LENGTH + 1];
-            strcpy(var_name, current_token->value);
-            current_token++;
-            if (current_token->type == Keyword && strcmp(current_token->value, "is") == 0) {
-                current_token++;
-                char var_value[MAX_STRING_LENGTH];
-                strcpy(var_value, current_token->value);
-                current_token++;
-                declare_variable(var_name, var_type);
-                assign_variable(var_name, var_value);
-            } else {
-                declare_variable(var_name, var_type);
-            }
-            if (current_token->type == Comma) {
-                current_token++;
-            }
-        }
-    } else if (current_token->type == Identifier) {
-        char var_name[MAX_IDENTIFIER_LENGTH + 1];
-        strcpy(var_name, current_token->value);
-        current_token++;
-        if (current_token->type == Keyword && strcmp(current_token->value, "is") == 0) {
-            current_token++;
-            char expression[MAX_STRING_LENGTH];
-            strcpy(expression, current_token->value);
-            current_token++;
-            while (current_token->type == Operator || current_token->type == Identifier || current_token->type == IntConst) {
-                strcat(expression, " ");
-                strcat(expression, current_token->value);
-                current_token++;
-            }
-            int result = evaluate_expression(expression);
-            char result_str[MAX_STRING_LENGTH];
-            sprintf(result_str, "%d", result);
-            assign_variable(var_name, result_str);
-        }
-    } else if (current_token->type == Keyword) {
-        if (strcmp(current_token->value, "read") == 0) {
-            current_token++;
-            handle_read(&current_token);
-        } else if (strcmp(current_token->value, "write") == 0 || strcmp(current_token->value, "newLine") == 0) {
-            handle_write(&current_token);
-        } else if (strcmp(current_token->value, "loop") == 0) {
-            handle_loop(&current_token);
-        }
-    }
-
-    // Handle end of line
-    if (current_token->type == EndOfLine) {
-        current_token++;
-    }
-
-    *tokens = current_token;
-}
-
-
-// Function to handle read statement
-void handle_read(Token** tokens) {
-    Token* current_token = *tokens;
-    while (current_token->type == Identifier) {
-        char var_name[MAX_IDENTIFIER_LENGTH + 1];
-        strcpy(var_name, current_token->value);
-        current_token++;
-        Variable* var = find_variable(var_name);
-        if (var == NULL) {
-            fprintf(stderr, "Runtime error: Variable %s not declared\n", var_name);
-            exit(EXIT_FAILURE);
-        }
-        if (var->type == Integer) {
-            int value;
-            printf("Enter integer value for %s: ", var_name);
-            scanf("%d", &value);
-            var->value.intValue = value;
-        } else {
-            char value[MAX_STRING_LENGTH];
-            printf("Enter string value for %s: ", var_name);
-            scanf("%s", value);
-            strcpy(var->value.strValue, value);
-        }
-        if (current_token->type == Comma) {
-            current_token++;
-        } else {
-            break;
-        }
-    }
-    if (current_token->type == EndOfLine) {
-        current_token++;
-    }
-    *tokens = current_token;
-}
-
-// Function to handle write and newLine statements
-void handle_write(Token** tokens) {
-    Token* current_token = *tokens;
-    if (strcmp(current_token->value, "write") == 0) {
-        current_token++;
-        while (current_token->type == Identifier || current_token->type == String) {
-            if (current_token->type == Identifier) {
-                Variable* var = find_variable(current_token->value);
-                if (var == NULL) {
-                    fprintf(stderr, "Runtime error: Variable %s not declared\n", current_token->value);
-                    exit(EXIT_FAILURE);
-                }
-                if (var->type == Integer) {
-                    printf("%d", var->value.intValue);
-                } else {
-                    printf("%s", var->value.strValue);
-                }
-            } else {
-                printf("%s", current_token->value);
-            }
-            current_token++;
-            if (current_token->type == Comma) {
-                current_token++;
-            } else {
-                break;
-            }
-        }
-        if (current_token->type == EndOfLine) {
-            current_token++;
-        }
-    } else if (strcmp(current_token->value, "newLine") == 0) {
-        printf("\n");
-        current_token++;
-        if (current_token->type == EndOfLine) {
-            current_token++;
-        }
-    }
-    *tokens = current_token;
-}
-
-// Function to handle loop statement
-void handle_loop(Token** tokens) {
-    Token* current_token = *tokens;
-    current_token++;
-    if (current_token->type == IntConst) {
-        int loop_count = atoi(current_token->value);
-        current_token++;
-        if (strcmp(current_token->value, "times") == 0) {
-            current_token++;
-            if (current_token->type == LeftCurlyBracket) {
-                current_token++;
-                Token* loop_body_start = current_token;
-                for (int i = 0; i < loop_count; i++) {
-                    current_token = loop_body_start;
-                    while (current_token->type != RightCurlyBracket) {
-                        execute_statement(&current_token);
-                    }
-                }
-                current_token++;
-            }
-        }
-    }
-    *tokens = current_token;
-}
-
-// Function to find a variable by name
-Variable* find_variable(const char* name) {
-    for (int i = 0; i < var_count; i++) {
-        if (strcmp(variables[i].name, name) == 0) {
-            return &variables[i];
-        }
-    }
-    return NULL;
-}
-
-// Function to declare a new variable
-void declare_variable(const char* name, enum VarType type) {
-    if (find_variable(name) != NULL) {
-        fprintf(stderr, "Semantic error: Variable already declared: %s\n", name);
-        exit(EXIT_FAILURE);
-    }
-    if (var_count >= MAX_VARIABLES) {
-        fprintf(stderr, "Semantic error: Too many variables declared\n");
-        exit(EXIT_FAILURE);
-    }
-    Variable* var = &variables[var_count++];
-    strncpy(var->name, name, MAX_IDENTIFIER_LENGTH);
-    var->name[MAX_IDENTIFIER_LENGTH] = '\0';
-    var->type = type;
-    if (type == Integer) {
-        var->value.intValue = 0;
-    } else {
-        var->value.strValue[0] = '\0';
-    }
-}
-
-int evaluate_expression(const char* expr) {
-    char buffer[MAX_STRING_LENGTH];
-    strncpy(buffer, expr, MAX_STRING_LENGTH);
-    buffer[MAX_STRING_LENGTH - 1] = '\0';
-
-    char* token = strtok(buffer, " ");
-    int result = 0;
-    char op = '+';
-
-    while (token != NULL) {
-        int value;
-
-        if (isdigit(token[0]) || (token[0] == '-' && isdigit(token[1]))) {
-            // Token is an integer constant
-            value = atoi(token);
-        } else {
-            // Token is a variable name
-            Variable* var = find_variable(token);
-            if (var == NULL) {
-                fprintf(stderr, "Semantic error: Undefined variable: %s\n", token);
-                exit(EXIT_FAILURE);
-            }
-            if (var->type != Integer) {
-                fprintf(stderr, "Semantic error: Variable is not an integer: %s\n", token);
-                exit(EXIT_FAILURE);
-            }
-            value = var->value.intValue;
-        }
-
-        switch (op) {
-            case '+': result += value; break;
-            case '-': result -= value; break;
-            case '*': result *= value; break;
-            case '/': 
-                if (value == 0) {
-                    fprintf(stderr, "Runtime error: Division by zero\n");
-                    exit(EXIT_FAILURE);
-                }
-                result /= value; 
-                break;
-            default:
-                fprintf(stderr, "Semantic error: Unknown operator: %c\n", op);
-                exit(EXIT_FAILURE);
-        }
-
-        token = strtok(NULL, " ");
-        if (token != NULL) {
-            op = token[0];
-            token = strtok(NULL, " ");
-        }
-    }
-
-    return result;
-}
-
-
-
-
-
-
-
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <sched.h>
+#include <stdatomic.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Define maximum sizes and other constants
+#define MAX_IDENTIFIER_LENGTH 10
+#define MAX_INTEGER_LENGTH 8
+#define MAX_STRING_LENGTH 256
+#define MAX_VARIABLES 100
+#define MAX_TOKEN_LENGTH 256
+#define MAX_INTEGER_VALUE 99999999
+#define MAX_LOOP_DEPTH 64
+#define INITIAL_CODE_CAPACITY 64
+#define VARSET_WORDS ((MAX_VARIABLES + 63) / 64)
+#define MAX_THREADS 64
+#define PARALLEL_MIN_WORK 100000 // Instructions a loop must execute before it is worth splitting
+#define PARALLEL_ROUND_ITERATIONS 16384 // Iterations per thread between two flushes of parallel output
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define STREAM_WINDOW_SIZE (64 * 1024)
+#define STREAM_TOKEN_CAPACITY 64
+#define ARENA_ALIGNMENT 16
+#define SNAPSHOT_MAGIC "STAR"
+#define SNAPSHOT_VERSION 1
+#define TRACE_MAGIC "STRC"
+#define TRACE_VERSION 3
+#define TRACE_BUFFER_SIZE (1 << 20) // Bytes per thread, a power of two
+#define TRACE_MAX_EVENT_SIZE 30     // Three varints of at most 10 bytes
+#define TRACE_IO_SAMPLE 16          // Every I/O instruction is timed once in this many runs
+
+// Trace timestamps use the time stamp counter where there is one
+#if defined(__x86_64__) || defined(__i386__)
+#define trace_clock() __rdtsc()
+#else
+#define trace_clock() monotonic_nanoseconds()
+#endif
+
+// Define token types
+enum TokenType {
+    Identifier,
+    IntConst,
+    Operator,
+    String,
+    Keyword,
+    EndOfLine,
+    Comma,
+    LeftCurlyBracket,
+    RightCurlyBracket,
+    Terminator,
+    LexicalError    // Error found by lex_token, value holds the message
+};
+
+// Define data types for variables
+enum VarType {
+    Integer,
+    Text
+};
+
+// Define opcodes of the compiled program
+enum OpCode {
+    OpAssign,       // integer dst is a, or dst is a <arith> b
+    OpTextAssign,   // text dst is a, a + b (concatenation) or a - b (removal), with text operands
+    OpTextFromInt,  // text dst is the decimal form of an integer expression
+    OpRead,     // read into dst, a holds the optional prompt
+    OpWrite,    // write a
+    OpNewLine,
+    OpLoop,     // enter a loop running a times, target is the matching OpEndLoop
+    OpEndLoop,  // count down, branch back to the body while iterations remain
+    OpNop,
+    OpHalt,
+    // Superinstructions, selected once the program has been optimized
+    OpAddConst,         // dst is dst + a, with an integer dst and a constant a
+    OpAddVars,          // dst is a + b, with integer variables only
+    OpWriteLine,        // write a, then newLine
+    OpAddConstEndLoop   // OpAddConst followed by OpEndLoop
+};
+
+// Define kinds of instruction operands
+enum OperandKind {
+    NoOperand,
+    ConstOperand,
+    VarOperand,
+    TextOperand
+};
+
+// Token structure
+typedef struct {
+    enum TokenType type;
+    char value[MAX_STRING_LENGTH];
+    int slot; // Identifier: variable slot resolved by analyze_program
+    int start;  // offset of the first character in the source
+    int end;    // offset just past the last character
+} Token;
+
+// Token of a token stream: its text stays in the stream's source, so only its position is kept
+typedef struct {
+    enum TokenType type;
+    int start;
+    int end;
+} StreamToken;
+
+// Token stream kept up to date by the incremental lexer. The source and the tokens are both held
+// in gap buffers placed at the last edit, so an edit only moves what lies between it and the
+// previous one; tokens after the gap store their positions relative to the end of the source
+typedef struct {
+    char* source;           // source_capacity characters and a '\0' that ends the text after the gap
+    int length;
+    int source_capacity;
+    int source_gap_start;   // characters before the gap
+    int source_gap_end;     // first character after the gap
+    StreamToken* tokens;
+    int capacity;
+    int gap_start;  // first free slot
+    int gap_end;    // first token after the gap
+    int count;      // tokens including the terminator
+    char error[MAX_TOKEN_LENGTH]; // message of the LexicalError token, if the stream ends in one
+} TokenStream;
+
+// Source file read piece by piece by --stream. The window starts at the first character that has
+// not been lexed yet, so the text of statements that already ran is not kept
+typedef struct {
+    FILE* file;
+    char* text;     // text[length] is '\0'
+    int length;
+    int capacity;
+    int position;   // next character to lex
+    int base;       // offset of text[0] in the file
+    bool eof;
+} SourceWindow;
+
+// Variable structure
+typedef struct {
+    char name[MAX_IDENTIFIER_LENGTH + 1];
+    enum VarType type;
+    union {
+        int intValue;
+        char strValue[MAX_STRING_LENGTH];
+    } value;
+    int length; // Text: number of characters in strValue
+} Variable;
+
+// Operand structure: an integer constant, a variable slot or an index into the text pool
+typedef struct {
+    enum OperandKind kind;
+    int value;
+} Operand;
+
+// Define the ways a summarized loop updates a variable
+enum UpdateKind {
+    SetUpdate,          // v is a [arith b], with loop-invariant operands
+    AddUpdate,          // v is v + step
+    SubtractUpdate,     // v is v - step, clamped at zero
+    AddInductionUpdate  // v is v + w, where w is an AddUpdate variable of the same loop
+};
+
+// Variable update structure of a summarized loop
+typedef struct {
+    enum UpdateKind kind;
+    int dst;
+    char arith;             // SetUpdate only
+    Operand a;              // SetUpdate only
+    Operand b;              // SetUpdate only
+    Operand step;           // loop-invariant step, or the induction variable for AddInductionUpdate
+    bool after_induction;   // AddInductionUpdate: w is updated before v in the body
+} VarUpdate;
+
+// Closed-form summary of a loop whose body only performs affine updates
+typedef struct {
+    VarUpdate* updates;
+    int count;
+} LoopSummary;
+
+// Define how a variable is treated when a loop's iterations run in parallel
+enum ParallelRole {
+    SharedVar,      // not written by the loop
+    InductionVar,   // v is v + step once per iteration; chunks start at v + first * step
+    ReductionVar,   // only updated as v is v + x; chunks sum from zero and totals are added
+    PrivateVar      // written before it is read in every iteration; ends as the last chunk left it
+};
+
+// Parallel execution plan of a loop whose iterations do not depend on each other
+typedef struct {
+    enum ParallelRole roles[MAX_VARIABLES];
+    Operand steps[MAX_VARIABLES]; // InductionVar: loop-invariant amount added per iteration
+} ParallelPlan;
+
+// Instruction structure
+typedef struct {
+    enum OpCode op;
+    char arith;     // '+', '-', '*' or '\0' for a plain copy
+    int dst;        // variable slot written by assignments and OpRead
+    Operand a;
+    Operand b;
+    int target;     // index of the matching OpLoop/OpEndLoop
+    LoopSummary* summary; // OpLoop: closed-form effect of the loop, or NULL
+    ParallelPlan* parallel; // OpLoop: how to split the loop across threads, or NULL
+    int source;     // offset of the statement in the source code
+} Instruction;
+
+// Compiled program structure
+typedef struct {
+    Instruction* code;
+    int count;
+    int capacity;
+    char** texts;
+    int* text_lengths;
+    int text_count;
+    int text_capacity;
+    int source;     // offset of the statement being compiled
+    int origin;     // index of code[0] in the full program, which parallel chunks copy a loop from
+} Program;
+
+// Execution state of a running program
+typedef struct {
+    Variable* vars;     // variable values, indexed by slot
+    FILE* output;       // where write and newLine print
+    jmp_buf* abort;     // parallel chunks: runtime errors jump here instead of exiting
+    int pc;             // where run_program starts, set by restore_checkpoint
+    int depth;          // number of active loops at pc
+    int loop_counters[MAX_LOOP_DEPTH]; // iterations left in each active loop
+} Machine;
+
+// One contiguous range of iterations of a parallel loop, run on a private copy of the variables
+typedef struct {
+    Program code;       // the loop alone, set to run this chunk's number of iterations
+    Variable* vars;
+    char* output;
+    size_t output_size;
+    bool failed;
+} ParallelChunk;
+
+// Thread pool running the chunks of parallel loops
+typedef struct {
+    pthread_t threads[MAX_THREADS];
+    int thread_count;
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    ParallelChunk* chunks;
+    int chunk_count;
+    int next_chunk;
+    int finished_chunks;
+} ThreadPool;
+
+// Set of variable slots used by the optimizer
+typedef struct {
+    unsigned long long bits[VARSET_WORDS];
+} VarSet;
+
+// What arena memory is used for, as reported by --mem-stats
+enum MemoryCategory {
+    SourceMemory,
+    TokenMemory,
+    SymbolMemory,   // the variable table
+    CodeMemory,     // instructions, loop summaries and parallel plans
+    TextMemory,     // the text pool of string constants
+    ScratchMemory,  // optimizer work arrays and parallel chunks, released after use
+    MemoryCategoryCount
+};
+
+// Block of memory handed out by the arena
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t size;
+    size_t used;
+    size_t id;              // order of a large block, see arena_mark
+    _Alignas(ARENA_ALIGNMENT) char data[];
+} ArenaBlock;
+
+// Region allocator owning the memory of a run
+typedef struct {
+    ArenaBlock* blocks;     // most recent first
+    ArenaBlock* large;      // allocations larger than ARENA_BLOCK_SIZE, one per block, most recent first
+    size_t large_count;     // ids given to large blocks
+    size_t used;            // bytes handed out
+    size_t peak;            // highest value of used
+    size_t reserved;        // bytes obtained from malloc
+    size_t peak_reserved;
+    size_t category_bytes[MemoryCategoryCount];
+    size_t category_peak[MemoryCategoryCount];
+} Arena;
+
+// Saved arena state, see arena_mark
+typedef struct {
+    ArenaBlock* block;
+    size_t block_used;
+    size_t large_count;
+    size_t used;
+    size_t category_bytes[MemoryCategoryCount];
+} ArenaMark;
+
+// Define kinds of trace events
+enum TraceEventKind {
+    LoopEnterEvent, // a loop starts
+    LoopExitEvent   // a loop has finished, with the iterations its closed form stood in for
+};
+
+// Define records of the trace file
+enum TraceRecord {
+    EventsRecord = 1,
+    EndRecord = 2,
+    CountsRecord = 3
+};
+
+// Define classes of instructions in the trace header
+enum TraceClass {
+    ComputeClass,
+    IoClass,
+    LoopClass,
+    ControlClass
+};
+
+// Ring buffer of encoded trace events written by one thread. Only the owning thread advances
+// head and only the flusher thread advances tail, so neither side takes a lock.
+typedef struct {
+    unsigned char data[TRACE_BUFFER_SIZE];
+    _Atomic size_t head;
+    _Atomic size_t tail;
+    size_t limit;                   // tail + TRACE_BUFFER_SIZE as last seen by the owning thread
+    unsigned long long last_clock;  // time of the thread's previous event
+    unsigned long long* counts;     // executions of every instruction of the program by the thread
+    unsigned long long* io_ticks;   // clock ticks of the timed runs of every I/O instruction
+    int thread;
+} TraceBuffer;
+
+// Trace recorder: the buffers of all threads, and the thread that writes them to the trace file
+typedef struct {
+    FILE* file;
+    int instruction_count;
+    TraceBuffer* buffers[MAX_THREADS + 1];
+    _Atomic int buffer_count;
+    pthread_mutex_t lock;   // serializes registration of new buffers
+    pthread_t flusher;
+    _Atomic bool stop;
+    unsigned long long start_clock;
+    unsigned long long start_time;
+    unsigned long long clock_cost;  // ticks between two consecutive clock reads
+} TraceRecorder;
+
+// Function prototypes
+void* arena_alloc(Arena* arena, size_t size, enum MemoryCategory category);
+void* arena_grow(Arena* arena, void* memory, size_t old_size, size_t new_size, enum MemoryCategory category);
+ArenaMark arena_mark(const Arena* arena);
+void arena_release(Arena* arena, ArenaMark mark);
+void arena_free(Arena* arena);
+void report_memory(void);
+char* read_source_code(const char* filepath);
+Token* tokenize_source_code(const char* source_code);
+void init_token_stream(TokenStream* stream, const char* source_code);
+void edit_token_stream(TokenStream* stream, int offset, int removed_length, const char* inserted);
+Token stream_token(const TokenStream* stream, int index);
+void copy_stream_source(const TokenStream* stream, int offset, int length, char* out);
+void free_token_stream(TokenStream* stream);
+void write_tokens_to_file(Token* tokens, const char* filename);
+void interpret(Token* tokens);
+void interpret_stream(const char* filepath);
+Variable* find_variable(const char* name);
+void declare_variable(const char* name, enum VarType type);
+void analyze_program(Token* tokens);
+void analyze_statement(Token** tokens, int depth);
+void analyze_declaration(Token** tokens);
+void analyze_assignment(Token** tokens);
+void analyze_read(Token** tokens);
+void analyze_write(Token** tokens);
+void analyze_loop(Token** tokens, int depth);
+void compile_program(Program* program, Token* tokens);
+void compile_statement(Program* program, Token** tokens);
+void compile_declaration(Program* program, Token** tokens);
+void compile_assignment(Program* program, Token** tokens);
+void compile_read(Program* program, Token** tokens);
+void compile_write(Program* program, Token** tokens);
+void compile_loop(Program* program, Token** tokens);
+void link_loops(Program* program);
+void optimize_program(Program* program);
+void summarize_loops(Program* program);
+void plan_parallel_loops(Program* program);
+void select_superinstructions(Program* program);
+bool apply_loop_summary(Machine* machine, const LoopSummary* summary, long long iterations);
+long long run_parallel_loop(const Program* program, Machine* machine, int loop_index, int depth, int* loop_counters);
+void dump_program(const Program* program, const char* title);
+void run_program(const Program* program, Machine* machine);
+void install_checkpoint_handlers(int interval);
+void save_checkpoint(const Program* program, const Machine* machine, int pc, int depth, const int* loop_counters);
+void restore_checkpoint(const Program* program, Machine* machine, const char* filepath);
+unsigned long long monotonic_nanoseconds(void);
+void start_trace(const Program* program, const char* source_path);
+void stop_trace(void);
+
+// Memory of the run
+Arena arena;
+
+// Global variable storage, allocated from the arena
+Variable* variables;
+int var_count = 0;
+
+// Command line options
+bool dump_ir = false;
+bool optimize_ir = true;
+int thread_count = 1;
+const char* checkpoint_file = NULL;
+const char* restore_file = NULL;
+const char* trace_path = NULL;
+const char* source_path = NULL;
+bool stream_source = false;
+
+// Trace recorder, and the trace buffer of the current thread
+TraceRecorder tracer = {.lock = PTHREAD_MUTEX_INITIALIZER};
+_Thread_local TraceBuffer* thread_trace_buffer = NULL;
+
+// Set by signal handlers, checked by the running program at loop iterations
+volatile sig_atomic_t checkpoint_pending = 0;
+volatile sig_atomic_t stop_after_checkpoint = 0;
+
+// Self-pipe the signal handlers write to, so that a read waiting for input wakes up
+int checkpoint_pipe[2] = {-1, -1};
+
+// Threads shared by all parallel loops, started on first use
+ThreadPool pool = {.lock = PTHREAD_MUTEX_INITIALIZER, .work_ready = PTHREAD_COND_INITIALIZER,
+                   .work_done = PTHREAD_COND_INITIALIZER};
+
+// Tests include this file with STAR_NO_MAIN defined and provide their own main
+#ifndef STAR_NO_MAIN
+int main(int argc, char* argv[]) {
+    const char* source_code_file = "code.sta";
+    int checkpoint_interval = 0;
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    thread_count = online < 1 ? 1 : online > MAX_THREADS ? MAX_THREADS : (int)online;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--dump-ir") == 0) {
+            dump_ir = true;
+        } else if (strcmp(argv[i], "-O0") == 0) {
+            optimize_ir = false;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 1) {
+            thread_count = atoi(argv[++i]);
+            if (thread_count > MAX_THREADS) thread_count = MAX_THREADS;
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            checkpoint_file = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-interval") == 0 && i + 1 < argc && atoi(argv[i + 1]) >= 1) {
+            checkpoint_interval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--restore") == 0 && i + 1 < argc) {
+            restore_file = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream_source = true;
+        } else if (strcmp(argv[i], "--mem-stats") == 0) {
+            atexit(report_memory); // Also reports runs that stop with an error
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            fprintf(stderr, "Usage: %s [--dump-ir] [-O0] [--threads N] [--mem-stats]\n"
+                            "       [--checkpoint FILE [--checkpoint-interval SECONDS]] [--restore FILE]\n"
+                            "       [--trace FILE] [--stream] [file.sta]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        } else {
+            source_code_file = argv[i];
+        }
+    }
+
+    source_path = source_code_file;
+    if (stream_source) {
+        if (checkpoint_file != NULL || restore_file != NULL || trace_path != NULL) {
+            fprintf(stderr, "Error: --stream cannot be combined with --checkpoint, --restore or --trace\n");
+            exit(EXIT_FAILURE);
+        }
+        variables = (Variable*)arena_alloc(&arena, MAX_VARIABLES * sizeof(Variable), SymbolMemory);
+        interpret_stream(source_code_file);
+        arena_free(&arena);
+        return 0;
+    }
+
+    char* source_code = read_source_code(source_code_file);
+
+    if (checkpoint_file != NULL) {
+        install_checkpoint_handlers(checkpoint_interval);
+    }
+
+    variables = (Variable*)arena_alloc(&arena, MAX_VARIABLES * sizeof(Variable), SymbolMemory);
+    Token* tokens = tokenize_source_code(source_code);
+    analyze_program(tokens);
+    interpret(tokens);
+
+    arena_free(&arena);
+    return 0;
+}
+#endif
+
+// Function to count bytes handed out by the arena towards the totals and peaks
+void account_memory(Arena* arena, size_t size, enum MemoryCategory category) {
+    arena->used += size;
+    arena->category_bytes[category] += size;
+    if (arena->used > arena->peak) {
+        arena->peak = arena->used;
+    }
+    if (arena->category_bytes[category] > arena->category_peak[category]) {
+        arena->category_peak[category] = arena->category_bytes[category];
+    }
+}
+
+// Function to count bytes obtained from malloc towards the reserved total and its peak
+void reserve_memory(Arena* arena, size_t size) {
+    arena->reserved += size;
+    if (arena->reserved > arena->peak_reserved) {
+        arena->peak_reserved = arena->reserved;
+    }
+}
+
+// Function to allocate a block of its own for an allocation larger than ARENA_BLOCK_SIZE, so
+// that arena_grow can resize it with realloc
+void* arena_alloc_large(Arena* arena, size_t size, enum MemoryCategory category) {
+    ArenaBlock* block = (ArenaBlock*)malloc(sizeof(ArenaBlock) + size);
+    if (block == NULL) {
+        perror("Memory allocation error");
+        exit(EXIT_FAILURE);
+    }
+    block->next = arena->large;
+    block->size = block->used = size;
+    block->id = arena->large_count++;
+    arena->large = block;
+    reserve_memory(arena, sizeof(ArenaBlock) + size);
+    account_memory(arena, size, category);
+    return block->data;
+}
+
+// Function to allocate memory from the arena; everything is released at once by arena_free
+void* arena_alloc(Arena* arena, size_t size, enum MemoryCategory category) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    if (size > ARENA_BLOCK_SIZE) {
+        return arena_alloc_large(arena, size, category);
+    }
+    ArenaBlock* block = arena->blocks;
+    if (block == NULL || block->size - block->used < size) {
+        block = (ArenaBlock*)malloc(sizeof(ArenaBlock) + ARENA_BLOCK_SIZE);
+        if (block == NULL) {
+            perror("Memory allocation error");
+            exit(EXIT_FAILURE);
+        }
+        block->next = arena->blocks;
+        block->size = ARENA_BLOCK_SIZE;
+        block->used = 0;
+        block->id = 0;
+        arena->blocks = block;
+        reserve_memory(arena, sizeof(ArenaBlock) + ARENA_BLOCK_SIZE);
+    }
+
+    void* memory = block->data + block->used;
+    block->used += size;
+    account_memory(arena, size, category);
+    return memory;
+}
+
+// Function to grow an allocation of the arena. A large allocation is resized with realloc. A
+// small one grows in place when it is the latest one and still fits in its block; otherwise it
+// is moved, and its old copy is handed back when it was the latest one.
+void* arena_grow(Arena* arena, void* memory, size_t old_size, size_t new_size, enum MemoryCategory category) {
+    old_size = (old_size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    new_size = (new_size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    if (old_size > ARENA_BLOCK_SIZE) {
+        ArenaBlock* block = (ArenaBlock*)((char*)memory - offsetof(ArenaBlock, data));
+        ArenaBlock** link = &arena->large;
+        while (*link != block) {
+            link = &(*link)->next;
+        }
+        block = (ArenaBlock*)realloc(block, sizeof(ArenaBlock) + new_size);
+        if (block == NULL) {
+            perror("Memory allocation error");
+            exit(EXIT_FAILURE);
+        }
+        *link = block;
+        reserve_memory(arena, new_size - block->size);
+        account_memory(arena, new_size - block->size, category);
+        block->size = block->used = new_size;
+        return block->data;
+    }
+
+    ArenaBlock* block = arena->blocks;
+    bool latest = block != NULL && (char*)memory + old_size == block->data + block->used;
+    if (latest && new_size <= ARENA_BLOCK_SIZE && block->size - block->used >= new_size - old_size) {
+        block->used += new_size - old_size;
+        account_memory(arena, new_size - old_size, category);
+        return memory;
+    }
+
+    void* moved = arena_alloc(arena, new_size, category);
+    memcpy(moved, memory, old_size);
+    if (latest && block == arena->blocks) {
+        block->used -= old_size;
+        arena->used -= old_size;
+        arena->category_bytes[category] -= old_size;
+    }
+    return moved;
+}
+
+// Function to remember the state of the arena, so that later allocations can be released
+// together. Memory allocated before the mark must not be grown until the mark is released.
+ArenaMark arena_mark(const Arena* arena) {
+    ArenaMark mark;
+    mark.block = arena->blocks;
+    mark.block_used = arena->blocks != NULL ? arena->blocks->used : 0;
+    mark.large_count = arena->large_count;
+    mark.used = arena->used;
+    memcpy(mark.category_bytes, arena->category_bytes, sizeof(mark.category_bytes));
+    return mark;
+}
+
+// Function to release everything allocated from the arena since a mark was taken
+void arena_release(Arena* arena, ArenaMark mark) {
+    while (arena->blocks != mark.block) {
+        ArenaBlock* block = arena->blocks;
+        arena->blocks = block->next;
+        arena->reserved -= sizeof(ArenaBlock) + block->size;
+        free(block);
+    }
+    if (arena->blocks != NULL) {
+        arena->blocks->used = mark.block_used;
+    }
+    while (arena->large != NULL && arena->large->id >= mark.large_count) {
+        ArenaBlock* block = arena->large;
+        arena->large = block->next;
+        arena->reserved -= sizeof(ArenaBlock) + block->size;
+        free(block);
+    }
+    arena->large_count = mark.large_count;
+    arena->used = mark.used;
+    memcpy(arena->category_bytes, mark.category_bytes, sizeof(arena->category_bytes));
+}
+
+// Function to release all memory of the arena; the peaks are kept for report_memory
+void arena_free(Arena* arena) {
+    ArenaMark empty = {NULL, 0, 0, 0, {0}};
+    arena_release(arena, empty);
+}
+
+// Function to print the peak memory use of the run, registered with atexit by --mem-stats
+void report_memory(void) {
+    static const char* names[MemoryCategoryCount] = {"source", "tokens", "symbols", "code", "texts", "scratch"};
+    fprintf(stderr, "Memory: peak %zu bytes allocated, %zu bytes reserved\n", arena.peak, arena.peak_reserved);
+    for (int category = 0; category < MemoryCategoryCount; category++) {
+        fprintf(stderr, "  %-8s %zu bytes\n", names[category], arena.category_peak[category]);
+    }
+}
+
+// Function to read source code from file
+char* read_source_code(const char* filepath) {
+    FILE* file = fopen(filepath, "r");
+    if (file == NULL) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    rewind(file);
+
+    char* source_code = (char*)arena_alloc(&arena, (file_size + 1) * sizeof(char), SourceMemory);
+    fread(source_code, sizeof(char), file_size, file);
+    source_code[file_size] = '\0';
+
+    fclose(file);
+
+    return source_code;
+}
+
+// Function to check if a character is a valid identifier character
+int is_valid_identifier_char(char ch) {
+    return isalnum(ch) || ch == '_';
+}
+
+// Function to turn a token into a lexical error detected at ptr
+const char* lexical_error(Token* token, const char* source, const char* ptr, const char* message) {
+    token->type = LexicalError;
+    token->start = token->end = (int)(ptr - source);
+    strcpy(token->value, message);
+    return ptr;
+}
+
+// Function to lex the next token at or after ptr, skipping whitespace and comments. Lexical errors
+// are returned as a LexicalError token holding the message, warnings through the warning pointer
+const char* lex_token(const char* source, const char* ptr, Token* token, const char** warning) {
+    bool in_comment = false; // Flag to track if we are inside a comment
+    *warning = NULL;
+    token->value[0] = '\0';
+    token->slot = -1;
+
+    while (*ptr != '\0') {
+        if (isspace(*ptr)) {
+            ptr++;
+            continue; // Skip whitespace
+        }
+
+        // Comments
+        if (*ptr == '/' && *(ptr + 1) == '*') {
+            in_comment = true; // Set the flag to true to mark start of comment
+            ptr += 2; // Skip the opening comment characters
+            continue; // Continue to the next character
+        }
+
+        // If we are inside a comment, skip characters until we find the end of the comment
+        if (in_comment) {
+            while (*ptr != '*' || *(ptr + 1) != '/') {
+                if (*ptr == '\0') {
+                    // If the comment doesn't terminate before the end of the file, lexical error
+                    return lexical_error(token, source, ptr, "Lexical error: Unterminated comment");
+                }
+                ptr++;
+            }
+            ptr += 2; // Skip the closing comment characters
+            in_comment = false; // Reset the flag as we've reached the end of the comment
+            continue; // Continue to the next character
+        }
+
+        const char* start = ptr;
+
+        // Keywords and Identifiers
+        if (isalpha(*ptr)) {
+            int i = 0;
+            while ((isalpha(*ptr) || *ptr == '_') && i < MAX_IDENTIFIER_LENGTH) {
+                token->value[i++] = *ptr++;
+            }
+            token->value[i] = '\0';
+
+            // Check if the word is a keyword
+            if (strcmp(token->value, "int") == 0 || strcmp(token->value, "text") == 0 ||
+                strcmp(token->value, "is") == 0 || strcmp(token->value, "loop") == 0 ||
+                strcmp(token->value, "times") == 0 || strcmp(token->value, "read") == 0 ||
+                strcmp(token->value, "write") == 0 || strcmp(token->value, "newLine") == 0) {
+                token->type = Keyword;
+            } else if (isalpha(*ptr) || *ptr == '_') {
+                return lexical_error(token, source, ptr, "Lexical error: Identifier exceeds maximum length");
+            } else {
+                token->type = Identifier;
+            }
+        }
+
+        // Integer constant
+        else if (isdigit(*ptr) || (*ptr == '-' && isdigit(*(ptr + 1)))) {
+            int i = 0;
+            if (*ptr == '-') {
+                token->value[i++] = *ptr++; // Include the minus sign
+            }
+            while (isdigit(*ptr) && i < MAX_INTEGER_LENGTH + 1) {
+                token->value[i++] = *ptr++;
+            }
+
+            if (i > MAX_INTEGER_LENGTH) {
+                return lexical_error(token, source, ptr, "Lexical error: Integer constant exceeds maximum length");
+            }
+
+            token->value[i] = '\0';
+            int value = atoi(token->value);
+            if (value < 0) {
+                value = 0;
+                *warning = "Lexical warning: Integer constant forced to zero";
+            }
+            sprintf(token->value, "%d", value);
+            token->type = IntConst;
+        }
+
+        // String constants
+        else if (*ptr == '"') {
+            int i = 0;
+            ptr++;
+            while (*ptr != '"' && *ptr != '\0' && i < MAX_STRING_LENGTH) {
+                token->value[i++] = *ptr++;
+            }
+            if (i >= MAX_STRING_LENGTH) {
+                return lexical_error(token, source, ptr, "Lexical error: String constant exceeds maximum length");
+            }
+            if (*ptr == '\0') {
+                return lexical_error(token, source, ptr, "Lexical error: Unterminated string constant");
+            }
+            ptr++;
+            token->value[i] = '\0';
+            token->type = String;
+        }
+
+        // End of line
+        else if (*ptr == '.') {
+            token->type = EndOfLine;
+            ptr++;
+        }
+
+        // Comma
+        else if (*ptr == ',') {
+            token->type = Comma;
+            ptr++;
+        }
+
+        // Operator tokens
+        else if (*ptr == '+' || *ptr == '-' || *ptr == '*') {
+            token->type = Operator;
+            token->value[0] = *ptr;
+            token->value[1] = '\0';
+            ptr++;
+        }
+
+        // Brackets
+        else if (*ptr == '{') {
+            token->type = LeftCurlyBracket;
+            ptr++;
+        }
+        else if (*ptr == '}') {
+            token->type = RightCurlyBracket;
+            ptr++;
+        }
+
+        // Move to next character
+        else {
+            ptr++;
+            continue;
+        }
+
+        token->start = (int)(start - source);
+        token->end = (int)(ptr - source);
+        return ptr;
+    }
+
+    // Add terminator token
+    token->type = Terminator;
+    token->start = token->end = (int)(ptr - source);
+    return ptr;
+}
+
+// Function to tokenize source code
+Token* tokenize_source_code(const char* source_code) {
+    int capacity = MAX_STRING_LENGTH;
+    Token* tokens = (Token*)arena_alloc(&arena, capacity * sizeof(Token), TokenMemory);
+
+    int num_tokens = 0;
+    const char* ptr = source_code;
+    do {
+        if (num_tokens == capacity) {
+            tokens = (Token*)arena_grow(&arena, tokens, capacity * sizeof(Token), 2 * capacity * sizeof(Token), TokenMemory);
+            capacity *= 2;
+        }
+
+        const char* warning;
+        ptr = lex_token(source_code, ptr, &tokens[num_tokens], &warning);
+        if (warning != NULL) {
+            fprintf(stderr, "%s\n", warning);
+        }
+        if (tokens[num_tokens].type == LexicalError) {
+            fprintf(stderr, "%s\n", tokens[num_tokens].value);
+            exit(EXIT_FAILURE);
+        }
+    } while (tokens[num_tokens++].type != Terminator);
+
+    return tokens;
+}
+
+// Function to create a token stream for incremental lexing, holding a copy of the source
+void init_token_stream(TokenStream* stream, const char* source_code) {
+    stream->length = 0;
+    stream->source_capacity = MAX_STRING_LENGTH;
+    stream->source = (char*)malloc(stream->source_capacity + 1);
+    stream->capacity = MAX_STRING_LENGTH;
+    stream->tokens = (StreamToken*)malloc(stream->capacity * sizeof(StreamToken));
+    if (stream->source == NULL || stream->tokens == NULL) {
+        perror("Memory allocation error");
+        exit(EXIT_FAILURE);
+    }
+    stream->source_gap_start = 0;
+    stream->source_gap_end = stream->source_capacity;
+    stream->source[stream->source_capacity] = '\0';
+    stream->error[0] = '\0';
+
+    // An empty source is just the terminator; lexing the whole file is one big insertion
+    StreamToken* terminator = &stream->tokens[stream->capacity - 1];
+    terminator->type = Terminator;
+    terminator->start = terminator->end = 0;
+    stream->gap_start = 0;
+    stream->gap_end = stream->capacity - 1;
+    stream->count = 1;
+    edit_token_stream(stream, 0, 0, source_code);
+}
+
+// Function to check if a token was lexed without looking at the source from offset on
+bool token_precedes(const StreamToken* token, int offset) {
+    return token->type != LexicalError && token->type != Terminator && token->end < offset;
+}
+
+// Function to move the gap of a token stream behind the last token that an edit at offset leaves intact
+void move_token_gap(TokenStream* stream, int offset) {
+    while (stream->gap_start > 0 && !token_precedes(&stream->tokens[stream->gap_start - 1], offset)) {
+        StreamToken* token = &stream->tokens[--stream->gap_end];
+        *token = stream->tokens[--stream->gap_start];
+        token->start -= stream->length;
+        token->end -= stream->length;
+    }
+    while (stream->gap_end < stream->capacity) {
+        StreamToken* token = &stream->tokens[stream->gap_end];
+        if (!token_precedes(token, offset - stream->length)) break;
+        token->start += stream->length;
+        token->end += stream->length;
+        stream->tokens[stream->gap_start++] = *token;
+        stream->gap_end++;
+    }
+}
+
+// Function to insert a token at the gap of a token stream
+void insert_stream_token(TokenStream* stream, const Token* token) {
+    if (stream->gap_start == stream->gap_end) {
+        int after = stream->capacity - stream->gap_end;
+        stream->capacity *= 2;
+        stream->tokens = (StreamToken*)realloc(stream->tokens, stream->capacity * sizeof(StreamToken));
+        if (stream->tokens == NULL) {
+            perror("Memory allocation error");
+            exit(EXIT_FAILURE);
+        }
+        stream->gap_end = stream->capacity - after;
+        memmove(&stream->tokens[stream->gap_end], &stream->tokens[stream->gap_start], after * sizeof(StreamToken));
+    }
+    StreamToken* slot = &stream->tokens[stream->gap_start++];
+    slot->type = token->type;
+    slot->start = token->start;
+    slot->end = token->end;
+    if (token->type == LexicalError) {
+        strcpy(stream->error, token->value);
+    }
+}
+
+// Function to move the gap of a token stream's source to offset
+void move_source_gap(TokenStream* stream, int offset) {
+    if (offset < stream->source_gap_start) {
+        int moved = stream->source_gap_start - offset;
+        stream->source_gap_end -= moved;
+        memmove(stream->source + stream->source_gap_end, stream->source + offset, moved);
+    } else if (offset > stream->source_gap_start) {
+        int moved = offset - stream->source_gap_start;
+        memmove(stream->source + stream->source_gap_start, stream->source + stream->source_gap_end, moved);
+        stream->source_gap_end += moved;
+    }
+    stream->source_gap_start = offset;
+}
+
+// Function to make room for inserting length characters at the gap of a token stream's source
+void reserve_source_gap(TokenStream* stream, int length) {
+    if (stream->source_gap_end - stream->source_gap_start >= length) {
+        return;
+    }
+    int after = stream->source_capacity - stream->source_gap_end;
+    int capacity = stream->source_capacity;
+    while (capacity - stream->length < length) {
+        capacity *= 2;
+    }
+    stream->source = (char*)realloc(stream->source, capacity + 1);
+    if (stream->source == NULL) {
+        perror("Memory allocation error");
+        exit(EXIT_FAILURE);
+    }
+    memmove(stream->source + capacity - after, stream->source + stream->source_gap_end, after + 1);
+    stream->source_gap_end = capacity - after;
+    stream->source_capacity = capacity;
+}
+
+// Function to apply an edit to a token stream: removed_length characters at offset are replaced by
+// inserted. Only tokens the edit can change are re-lexed: lexing restarts behind the last token that
+// ended before the edit (each token looks one character past its end), and stops as soon as a new
+// token ends where an old token ended behind the edit, since the lexer carries no state from one
+// token to the next. The source gap is left where lexing restarts, so that the text from there on
+// is in one piece. Tokens after the gap keep their positions relative to the end of the source,
+// so the tokens after the edit are neither moved nor renumbered.
+void edit_token_stream(TokenStream* stream, int offset, int removed_length, const char* inserted) {
+    int inserted_length = (int)strlen(inserted);
+    if (offset < 0 || removed_length < 0 || offset + removed_length > stream->length) {
+        fprintf(stderr, "Error: Edit is outside of the source\n");
+        exit(EXIT_FAILURE);
+    }
+    move_token_gap(stream, offset);
+
+    // Splice the edit into the source
+    move_source_gap(stream, offset);
+    stream->source_gap_end += removed_length;
+    stream->length -= removed_length;
+    reserve_source_gap(stream, inserted_length);
+    memcpy(stream->source + stream->source_gap_start, inserted, inserted_length);
+    stream->source_gap_start += inserted_length;
+    stream->length += inserted_length;
+    int length = stream->length;
+
+    int restart = stream->gap_start > 0 ? stream->tokens[stream->gap_start - 1].end : 0;
+    move_source_gap(stream, restart);
+    const char* text = stream->source + stream->source_gap_end; // The source from restart on
+    const char* ptr = text;
+    Token token;
+    const char* warning;
+    do {
+        ptr = lex_token(text, ptr, &token, &warning);
+        token.start += restart;
+        token.end += restart;
+        if (token.type == Terminator || token.type == LexicalError) {
+            // Nothing after the end of the source or a lexical error is kept
+            stream->gap_end = stream->capacity;
+            insert_stream_token(stream, &token);
+            if (token.type == LexicalError) {
+                token.type = Terminator;
+                token.start = token.end = length;
+                insert_stream_token(stream, &token);
+            }
+            break;
+        }
+
+        // Drop the old tokens this one overlaps, and stop when it ends where an old token ended
+        int end = token.end - length;
+        while (stream->gap_end < stream->capacity && stream->tokens[stream->gap_end].end < end) {
+            stream->gap_end++;
+        }
+        insert_stream_token(stream, &token);
+        if (token.end >= offset + inserted_length && stream->tokens[stream->gap_end].end == end &&
+            stream->tokens[stream->gap_end].type != LexicalError && stream->tokens[stream->gap_end].type != Terminator) {
+            stream->gap_end++;
+            break;
+        }
+    } while (true);
+
+    stream->count = stream->gap_start + stream->capacity - stream->gap_end;
+}
+
+// Function to copy length characters of a token stream's source, starting at offset
+void copy_stream_source(const TokenStream* stream, int offset, int length, char* out) {
+    int before = offset < stream->source_gap_start ? stream->source_gap_start - offset : 0;
+    if (before > length) {
+        before = length;
+    }
+    memcpy(out, stream->source + offset, before);
+    int after_offset = offset + before - stream->source_gap_start + stream->source_gap_end;
+    memcpy(out + before, stream->source + after_offset, length - before);
+}
+
+// Function to get a token of a token stream, with its position in the current source. The value
+// is lexed again from the token's text.
+Token stream_token(const TokenStream* stream, int index) {
+    StreamToken position;
+    if (index < stream->gap_start) {
+        position = stream->tokens[index];
+    } else {
+        position = stream->tokens[index - stream->gap_start + stream->gap_end];
+        position.start += stream->length;
+        position.end += stream->length;
+    }
+
+    Token token;
+    if (position.type == LexicalError) {
+        strcpy(token.value, stream->error);
+    } else if (position.type == Terminator) {
+        token.value[0] = '\0';
+    } else {
+        char text[MAX_STRING_LENGTH + 3]; // The longest token is a string constant and its quotes
+        copy_stream_source(stream, position.start, position.end - position.start, text);
+        text[position.end - position.start] = '\0';
+        const char* warning;
+        lex_token(text, text, &token, &warning);
+    }
+    token.type = position.type;
+    token.slot = -1;
+    token.start = position.start;
+    token.end = position.end;
+    return token;
+}
+
+// Function to free a token stream
+void free_token_stream(TokenStream* stream) {
+    free(stream->source);
+    free(stream->tokens);
+}
+
+// Function to open a source file for streaming; "-" streams from standard input
+void open_source_window(SourceWindow* window, const char* filepath) {
+    window->file = strcmp(filepath, "-") == 0 ? stdin : fopen(filepath, "r");
+    if (window->file == NULL) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+    window->capacity = STREAM_WINDOW_SIZE;
+    window->text = (char*)arena_alloc(&arena, window->capacity + 1, SourceMemory);
+    window->text[0] = '\0';
+    window->length = 0;
+    window->position = 0;
+    window->base = 0;
+    window->eof = false;
+}
+
+// Function to read more of the file into the window, dropping the text that has been lexed. The
+// window only grows when a single token or comment does not fit in it.
+void read_source_window(SourceWindow* window) {
+    window->length -= window->position;
+    memmove(window->text, window->text + window->position, window->length);
+    window->base += window->position;
+    window->position = 0;
+
+    if (window->length == window->capacity) {
+        window->text = (char*)arena_grow(&arena, window->text, window->capacity + 1, 2 * window->capacity + 1, SourceMemory);
+        window->capacity *= 2;
+    }
+    size_t read = fread(window->text + window->length, sizeof(char), window->capacity - window->length, window->file);
+    window->length += (int)read;
+    window->text[window->length] = '\0';
+    if (read == 0) {
+        window->eof = true;
+    }
+}
+
+// Function to lex the next token of a streamed file, with offsets in the file
+void lex_stream_token(SourceWindow* window, Token* token) {
+    while (true) {
+        const char* warning;
+        const char* ptr = lex_token(window->text, window->text + window->position, token, &warning);
+        // A token, comment or string that reaches the end of the window may go on in the file
+        if (ptr < window->text + window->length || window->eof) {
+            if (warning != NULL) {
+                fprintf(stderr, "%s\n", warning);
+            }
+            window->position = (int)(ptr - window->text);
+            token->start += window->base;
+            token->end += window->base;
+            return;
+        }
+        read_source_window(window);
+    }
+}
+
+// Function to lex the next top-level statement of a streamed file, followed by a terminator. A
+// statement ends at a '.' or '}' outside of any block, so of a loop only its own block is held.
+// Returns false at the end of the file.
+bool read_stream_statement(SourceWindow* window, Token** tokens, int* capacity) {
+    int count = 0;
+    int depth = 0;
+    while (true) {
+        if (count + 1 >= *capacity) {
+            *tokens = (Token*)arena_grow(&arena, *tokens, *capacity * sizeof(Token), 2 * *capacity * sizeof(Token), TokenMemory);
+            *capacity *= 2;
+        }
+        Token* token = &(*tokens)[count++];
+        lex_stream_token(window, token);
+        if (token->type == LexicalError) {
+            fprintf(stderr, "%s\n", token->value);
+            exit(EXIT_FAILURE);
+        }
+        if (token->type == Terminator) {
+            return count > 1;
+        }
+        if (token->type == LeftCurlyBracket) {
+            depth++;
+        } else if (token->type == RightCurlyBracket) {
+            depth--;
+        }
+        if (depth <= 0 && (token->type == EndOfLine || token->type == RightCurlyBracket)) {
+            break;
+        }
+    }
+
+    Token* terminator = &(*tokens)[count];
+    terminator->type = Terminator;
+    terminator->value[0] = '\0';
+    terminator->slot = -1;
+    terminator->start = terminator->end = (*tokens)[count - 1].end;
+    return true;
+}
+
+// Function to interpret a file one top-level statement at a time, as it is read. Each statement
+// is checked, compiled, optimized and run before the next one is lexed, and its memory is
+// released after it ran, so memory use follows the largest loop rather than the file.
+void interpret_stream(const char* filepath) {
+    SourceWindow window;
+    open_source_window(&window, filepath);
+    int capacity = STREAM_TOKEN_CAPACITY;
+    Token* tokens = (Token*)arena_alloc(&arena, capacity * sizeof(Token), TokenMemory);
+
+    while (read_stream_statement(&window, &tokens, &capacity)) {
+        ArenaMark mark = arena_mark(&arena);
+        analyze_program(tokens);
+        interpret(tokens);
+        arena_release(&arena, mark);
+    }
+
+    if (window.file != stdin) {
+        fclose(window.file);
+    }
+}
+
+// Function to interpret tokens
+void interpret(Token* tokens) {
+    Program program;
+    compile_program(&program, tokens);
+
+    if (dump_ir) {
+        dump_program(&program, "before optimization");
+    }
+    if (optimize_ir) {
+        optimize_program(&program);
+    }
+    if (dump_ir) {
+        dump_program(&program, "after optimization");
+    }
+
+    Machine machine = {variables, stdout, NULL};
+    if (restore_file != NULL) {
+        restore_checkpoint(&program, &machine, restore_file);
+    }
+    if (trace_path != NULL) {
+        start_trace(&program, source_path);
+    }
+    // Once the trace flusher or the thread pool runs, stdio locks the stream on every call; only
+    // this thread writes the program's output, so it holds the lock for the whole run instead
+    flockfile(machine.output);
+    run_program(&program, &machine);
+    funlockfile(machine.output);
+}
+
+// Function to append an instruction to the program
+int emit(Program* program, Instruction instruction) {
+    if (program->count == program->capacity) {
+        program->code = (Instruction*)arena_grow(&arena, program->code, program->capacity * sizeof(Instruction),
+                                                 2 * program->capacity * sizeof(Instruction), CodeMemory);
+        program->capacity *= 2;
+    }
+    program->code[program->count] = instruction;
+    program->code[program->count].source = program->source;
+    return program->count++;
+}
+
+// Function to add a string constant to the text pool
+int add_text(Program* program, const char* text) {
+    if (program->text_count == program->text_capacity) {
+        int capacity = program->text_capacity ? program->text_capacity * 2 : 16;
+        char** texts = (char**)arena_alloc(&arena, capacity * sizeof(char*), TextMemory);
+        int* text_lengths = (int*)arena_alloc(&arena, capacity * sizeof(int), TextMemory);
+        if (program->text_count > 0) {
+            memcpy(texts, program->texts, program->text_count * sizeof(char*));
+            memcpy(text_lengths, program->text_lengths, program->text_count * sizeof(int));
+        }
+        program->texts = texts;
+        program->text_lengths = text_lengths;
+        program->text_capacity = capacity;
+    }
+    int length = (int)strlen(text);
+    program->texts[program->text_count] = (char*)arena_alloc(&arena, length + 1, TextMemory);
+    memcpy(program->texts[program->text_count], text, length + 1);
+    program->text_lengths[program->text_count] = length;
+    return program->text_count++;
+}
+
+// Function to check whether a keyword token has the given text
+bool is_keyword(const Token* token, const char* keyword) {
+    return token->type == Keyword && strcmp(token->value, keyword) == 0;
+}
+
+// Function to check declarations, resolve identifiers and infer operation types before execution
+void analyze_program(Token* tokens) {
+    Token* current_token = tokens;
+    while (current_token->type != Terminator) {
+        analyze_statement(&current_token, 0);
+    }
+}
+
+// Function to require the '.' that ends a simple statement
+void expect_end_of_line(Token** tokens) {
+    if ((*tokens)->type != EndOfLine) {
+        fprintf(stderr, "Syntax error: Missing '.' at end of statement\n");
+        exit(EXIT_FAILURE);
+    }
+    (*tokens)++;
+}
+
+void analyze_statement(Token** tokens, int depth) {
+    Token* current_token = *tokens;
+
+    if (is_keyword(current_token, "int") || is_keyword(current_token, "text")) {
+        analyze_declaration(&current_token);
+        expect_end_of_line(&current_token);
+    } else if (current_token->type == Identifier) {
+        analyze_assignment(&current_token);
+        expect_end_of_line(&current_token);
+    } else if (is_keyword(current_token, "read")) {
+        current_token++;
+        analyze_read(&current_token);
+        expect_end_of_line(&current_token);
+    } else if (is_keyword(current_token, "write") || is_keyword(current_token, "newLine")) {
+        analyze_write(&current_token);
+        expect_end_of_line(&current_token);
+    } else if (is_keyword(current_token, "loop")) {
+        analyze_loop(&current_token, depth);
+    } else if (current_token->type == EndOfLine) {
+        current_token++; // Empty statement
+    } else {
+        fprintf(stderr, "Syntax error: Unexpected token at start of statement\n");
+        exit(EXIT_FAILURE);
+    }
+
+    *tokens = current_token;
+}
+
+// Function to bind an identifier token to its declared variable
+Variable* resolve_identifier(Token* token) {
+    Variable* var = find_variable(token->value);
+    if (var == NULL) {
+        fprintf(stderr, "Semantic error: Undefined variable: %s\n", token->value);
+        exit(EXIT_FAILURE);
+    }
+    token->slot = (int)(var - variables);
+    return var;
+}
+
+// Function to check an operand token and return the type of its value
+enum VarType analyze_operand(Token* token) {
+    if (token->type == IntConst) {
+        return Integer;
+    }
+    if (token->type == String) {
+        return Text;
+    }
+    if (token->type == Identifier) {
+        return resolve_identifier(token)->type;
+    }
+    fprintf(stderr, "Syntax error: Expected a constant or a variable\n");
+    exit(EXIT_FAILURE);
+}
+
+// Function to check that a value of the given operand types can be stored in a variable.
+// Integer variables take integer expressions only; text variables take a text value, '+'
+// (concatenation) or '-' (removal) of two text values, or an integer expression.
+void check_assignment(const Variable* var, enum VarType a, char arith, enum VarType b) {
+    if (var->type == Integer) {
+        if (a != Integer || (arith != '\0' && b != Integer)) {
+            fprintf(stderr, "Semantic error: Text value assigned to integer variable: %s\n", var->name);
+            exit(EXIT_FAILURE);
+        }
+    } else if (arith != '\0' && a != b) {
+        fprintf(stderr, "Semantic error: Text and integer operands mixed in assignment to %s\n", var->name);
+        exit(EXIT_FAILURE);
+    } else if (arith == '*' && a == Text) {
+        fprintf(stderr, "Semantic error: Operator * is not defined for text in assignment to %s\n", var->name);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Function to check a variable declaration with optional initializers
+void analyze_declaration(Token** tokens) {
+    Token* current_token = *tokens;
+    enum VarType var_type = is_keyword(current_token, "int") ? Integer : Text;
+    current_token++;
+    while (current_token->type == Identifier) {
+        declare_variable(current_token->value, var_type);
+        Variable* var = resolve_identifier(current_token);
+        current_token++;
+        if (is_keyword(current_token, "is")) {
+            current_token++;
+            check_assignment(var, analyze_operand(current_token), '\0', Integer);
+            current_token++;
+        }
+        if (current_token->type == Comma) {
+            current_token++;
+        }
+    }
+    *tokens = current_token;
+}
+
+// Function to check an assignment of a constant, variable or two-operand expression
+void analyze_assignment(Token** tokens) {
+    Token* current_token = *tokens;
+    Variable* var = resolve_identifier(current_token);
+    current_token++;
+    if (!is_keyword(current_token, "is")) {
+        fprintf(stderr, "Syntax error: Expected 'is' after %s\n", var->name);
+        exit(EXIT_FAILURE);
+    }
+    current_token++;
+
+    enum VarType a = analyze_operand(current_token);
+    enum VarType b = Integer;
+    char arith = '\0';
+    current_token++;
+    if (current_token->type == Operator) {
+        arith = current_token->value[0];
+        current_token++;
+        b = analyze_operand(current_token);
+        current_token++;
+    }
+    if (current_token->type == Operator) {
+        fprintf(stderr, "Syntax error: Expressions must be simple (two operands max)\n");
+        exit(EXIT_FAILURE);
+    }
+
+    check_assignment(var, a, arith, b);
+    *tokens = current_token;
+}
+
+// Function to check a read statement
+void analyze_read(Token** tokens) {
+    Token* current_token = *tokens;
+    if (current_token->type == String) {
+        current_token++;
+    }
+    while (current_token->type == Identifier) {
+        resolve_identifier(current_token);
+        current_token++;
+        if (current_token->type == Comma) {
+            current_token++;
+        } else {
+            break;
+        }
+    }
+    *tokens = current_token;
+}
+
+// Function to check write and newLine statements
+void analyze_write(Token** tokens) {
+    Token* current_token = *tokens;
+    if (is_keyword(current_token, "newLine")) {
+        *tokens = current_token + 1;
+        return;
+    }
+
+    current_token++;
+    while (current_token->type == Identifier || current_token->type == String || is_keyword(current_token, "newLine")) {
+        if (current_token->type == Identifier) {
+            resolve_identifier(current_token);
+        }
+        current_token++;
+        if (current_token->type == Comma) {
+            current_token++;
+        } else {
+            break;
+        }
+    }
+    *tokens = current_token;
+}
+
+// Function to check a loop with a block or a single statement as its body
+void analyze_loop(Token** tokens, int depth) {
+    Token* current_token = *tokens;
+    current_token++;
+    if (current_token->type != IntConst) {
+        fprintf(stderr, "Syntax error: Loop count must be an integer constant\n");
+        exit(EXIT_FAILURE);
+    }
+    if (depth >= MAX_LOOP_DEPTH) {
+        fprintf(stderr, "Semantic error: Loops nested too deeply\n");
+        exit(EXIT_FAILURE);
+    }
+    current_token++;
+    if (!is_keyword(current_token, "times")) {
+        fprintf(stderr, "Syntax error: Expected 'times' after loop count\n");
+        exit(EXIT_FAILURE);
+    }
+    current_token++;
+
+    if (current_token->type == LeftCurlyBracket) {
+        current_token++;
+        while (current_token->type != RightCurlyBracket) {
+            if (current_token->type == Terminator) {
+                fprintf(stderr, "Syntax error: Missing '}' at end of loop\n");
+                exit(EXIT_FAILURE);
+            }
+            analyze_statement(&current_token, depth + 1);
+        }
+        current_token++;
+    } else {
+        analyze_statement(&current_token, depth + 1);
+    }
+    *tokens = current_token;
+}
+
+// Function to compile the analyzed token stream into a program
+void compile_program(Program* program, Token* tokens) {
+    program->capacity = INITIAL_CODE_CAPACITY;
+    program->count = 0;
+    program->code = (Instruction*)arena_alloc(&arena, program->capacity * sizeof(Instruction), CodeMemory);
+    program->texts = NULL;
+    program->text_lengths = NULL;
+    program->text_count = 0;
+    program->text_capacity = 0;
+    program->source = -1;
+    program->origin = 0;
+
+    Token* current_token = tokens;
+    while (current_token->type != Terminator) {
+        compile_statement(program, &current_token);
+    }
+
+    Instruction halt = {OpHalt, '\0', -1, {NoOperand, 0}, {NoOperand, 0}, -1};
+    emit(program, halt);
+    link_loops(program);
+}
+
+// Statements are compiled from tokens that analyze_program has already accepted,
+// so the compiler only follows the grammar and does not report errors itself
+void compile_statement(Program* program, Token** tokens) {
+    Token* current_token = *tokens;
+    program->source = current_token->start;
+
+    if (is_keyword(current_token, "int") || is_keyword(current_token, "text")) {
+        compile_declaration(program, &current_token);
+    } else if (current_token->type == Identifier) {
+        compile_assignment(program, &current_token);
+    } else if (is_keyword(current_token, "read")) {
+        current_token++;
+        compile_read(program, &current_token);
+    } else if (is_keyword(current_token, "write") || is_keyword(current_token, "newLine")) {
+        compile_write(program, &current_token);
+    } else if (is_keyword(current_token, "loop")) {
+        compile_loop(program, &current_token);
+    }
+
+    if (current_token->type == EndOfLine) {
+        current_token++;
+    }
+    *tokens = current_token;
+}
+
+// Function to compile a constant or resolved variable reference
+Operand compile_operand(Program* program, const Token* token) {
+    Operand operand = {NoOperand, 0};
+    if (token->type == IntConst) {
+        operand.kind = ConstOperand;
+        operand.value = atoi(token->value);
+    } else if (token->type == String) {
+        operand.kind = TextOperand;
+        operand.value = add_text(program, token->value);
+    } else {
+        operand.kind = VarOperand;
+        operand.value = token->slot;
+    }
+    return operand;
+}
+
+// Function to emit an assignment, choosing the opcode from the types the analyzer checked
+void compile_store(Program* program, int dst, const Token* a_token, char arith, const Token* b_token) {
+    Operand a = compile_operand(program, a_token);
+    Operand b = {NoOperand, 0};
+    if (arith != '\0') {
+        b = compile_operand(program, b_token);
+    }
+
+    enum OpCode op = OpAssign;
+    if (variables[dst].type == Text) {
+        bool text_value = a.kind == TextOperand || (a.kind == VarOperand && variables[a.value].type == Text);
+        op = text_value ? OpTextAssign : OpTextFromInt;
+    }
+    Instruction instruction = {op, arith, dst, a, b, -1};
+    emit(program, instruction);
+}
+
+// Function to compile a variable declaration with optional initializers
+void compile_declaration(Program* program, Token** tokens) {
+    Token* current_token = *tokens;
+    current_token++;
+    while (current_token->type == Identifier) {
+        int slot = current_token->slot;
+        current_token++;
+        if (is_keyword(current_token, "is")) {
+            current_token++;
+            compile_store(program, slot, current_token, '\0', NULL);
+            current_token++;
+        }
+        if (current_token->type == Comma) {
+            current_token++;
+        }
+    }
+    *tokens = current_token;
+}
+
+// Function to compile an assignment of a constant, variable or two-operand expression
+void compile_assignment(Program* program, Token** tokens) {
+    Token* current_token = *tokens;
+    int slot = current_token->slot;
+    current_token += 2; // Skip the variable and 'is'
+
+    const Token* a = current_token++;
+    if (current_token->type == Operator) {
+        char arith = current_token->value[0];
+        compile_store(program, slot, a, arith, current_token + 1);
+        current_token += 2;
+    } else {
+        compile_store(program, slot, a, '\0', NULL);
+    }
+    *tokens = current_token;
+}
+
+// Function to compile a read statement
+void compile_read(Program* program, Token** tokens) {
+    Token* current_token = *tokens;
+    Operand prompt = {NoOperand, 0};
+    if (current_token->type == String) {
+        prompt.kind = TextOperand;
+        prompt.value = add_text(program, current_token->value);
+        current_token++;
+    }
+    while (current_token->type == Identifier) {
+        Instruction instruction = {OpRead, '\0', current_token->slot, prompt, {NoOperand, 0}, -1};
+        emit(program, instruction);
+        prompt.kind = NoOperand; // The prompt is shown once, before the first variable
+        current_token++;
+        if (current_token->type == Comma) {
+            current_token++;
+        } else {
+            break;
+        }
+    }
+    *tokens = current_token;
+}
+
+// Function to compile write and newLine statements
+void compile_write(Program* program, Token** tokens) {
+    Token* current_token = *tokens;
+    Instruction new_line = {OpNewLine, '\0', -1, {NoOperand, 0}, {NoOperand, 0}, -1};
+    if (is_keyword(current_token, "newLine")) {
+        emit(program, new_line);
+        *tokens = current_token + 1;
+        return;
+    }
+
+    current_token++;
+    while (current_token->type == Identifier || current_token->type == String || is_keyword(current_token, "newLine")) {
+        if (current_token->type == Keyword) {
+            emit(program, new_line);
+        } else {
+            Instruction instruction = {OpWrite, '\0', -1, compile_operand(program, current_token), {NoOperand, 0}, -1};
+            emit(program, instruction);
+        }
+        current_token++;
+        if (current_token->type == Comma) {
+            current_token++;
+        } else {
+            break;
+        }
+    }
+    *tokens = current_token;
+}
+
+// Function to compile a loop with a block or a single statement as its body
+void compile_loop(Program* program, Token** tokens) {
+    Token* current_token = *tokens;
+    current_token++;
+    Instruction loop = {OpLoop, '\0', -1, {ConstOperand, atoi(current_token->value)}, {NoOperand, 0}, -1};
+    current_token += 2; // Skip the count and 'times'
+
+    int loop_index = emit(program, loop);
+    if (current_token->type == LeftCurlyBracket) {
+        current_token++;
+        while (current_token->type != RightCurlyBracket) {
+            compile_statement(program, &current_token);
+        }
+        current_token++;
+    } else {
+        compile_statement(program, &current_token);
+    }
+
+    Instruction end_loop = {OpEndLoop, '\0', -1, {NoOperand, 0}, {NoOperand, 0}, loop_index};
+    program->source = program->code[loop_index].source;
+    program->code[loop_index].target = emit(program, end_loop);
+    *tokens = current_token;
+}
+
+// Function to check whether an opcode closes a loop
+bool is_loop_end(enum OpCode op) {
+    return op == OpEndLoop || op == OpAddConstEndLoop;
+}
+
+// Function to pair every OpLoop with its OpEndLoop after instructions have moved
+void link_loops(Program* program) {
+    int stack[MAX_LOOP_DEPTH];
+    int depth = 0;
+    for (int i = 0; i < program->count; i++) {
+        if (program->code[i].op == OpLoop) {
+            stack[depth++] = i;
+        } else if (is_loop_end(program->code[i].op)) {
+            int loop_index = stack[--depth];
+            program->code[loop_index].target = i;
+            program->code[i].target = loop_index;
+        }
+    }
+}
+
+// Variable set helpers
+void varset_clear(VarSet* set) {
+    memset(set->bits, 0, sizeof(set->bits));
+}
+
+void varset_add(VarSet* set, int slot) {
+    set->bits[slot / 64] |= 1ULL << (slot % 64);
+}
+
+void varset_remove(VarSet* set, int slot) {
+    set->bits[slot / 64] &= ~(1ULL << (slot % 64));
+}
+
+bool varset_has(const VarSet* set, int slot) {
+    return (set->bits[slot / 64] >> (slot % 64)) & 1ULL;
+}
+
+void varset_add_operand(VarSet* set, Operand operand) {
+    if (operand.kind == VarOperand) {
+        varset_add(set, operand.value);
+    }
+}
+
+// Function to apply an integer operator; the result is not yet clamped or range checked
+long long apply_arith(char arith, long long a, long long b) {
+    switch (arith) {
+        case '+': return a + b;
+        case '-': return a - b;
+        case '*': return a * b;
+        default:
+            fprintf(stderr, "Semantic error: Unknown operator: %c\n", arith);
+            exit(EXIT_FAILURE);
+    }
+}
+
+// Function to check whether an opcode stores the result of an expression in dst
+bool is_assignment(enum OpCode op) {
+    return op == OpAssign || op == OpTextAssign || op == OpTextFromInt;
+}
+
+// Function to check whether an instruction writes a variable
+bool writes_variable(enum OpCode op) {
+    return is_assignment(op) || op == OpRead;
+}
+
+// Function to check whether executing an instruction can stop the program with an error.
+// Types were checked before compilation, so only integer arithmetic and input can fail.
+bool instruction_may_fail(const Instruction* instruction) {
+    if (instruction->op == OpRead) {
+        return true;
+    }
+    if (instruction->op != OpAssign && instruction->op != OpTextFromInt) {
+        return false;
+    }
+    if (instruction->arith == '\0' || instruction->arith == '-') {
+        return false; // Both operands are within range, so the difference is too
+    }
+    return instruction->a.kind != ConstOperand || instruction->b.kind != ConstOperand ||
+           apply_arith(instruction->arith, instruction->a.value, instruction->b.value) > MAX_INTEGER_VALUE;
+}
+
+// Function to check whether an instruction produces input or output
+bool instruction_does_io(const Instruction* instruction) {
+    return instruction->op == OpRead || instruction->op == OpWrite || instruction->op == OpNewLine ||
+           instruction->op == OpWriteLine;
+}
+
+// Function to collect the variables assigned between two instruction indices
+void collect_assigned(const Program* program, int start, int end, VarSet* assigned) {
+    varset_clear(assigned);
+    for (int i = start; i < end; i++) {
+        if (writes_variable(program->code[i].op)) {
+            varset_add(assigned, program->code[i].dst);
+        }
+    }
+}
+
+// Function to drop OpNop instructions and re-pair loops
+void remove_nops(Program* program) {
+    int count = 0;
+    for (int i = 0; i < program->count; i++) {
+        if (program->code[i].op != OpNop) {
+            program->code[count++] = program->code[i];
+        }
+    }
+    program->count = count;
+    link_loops(program);
+}
+
+// Function to remove loops that run zero times or whose bodies are empty
+void remove_dead_loops(Program* program) {
+    for (int i = 0; i < program->count; i++) {
+        Instruction* instruction = &program->code[i];
+        if (instruction->op == OpLoop && instruction->a.value <= 0) {
+            for (int j = i; j <= instruction->target; j++) {
+                program->code[j].op = OpNop;
+            }
+        } else if (instruction->op == OpEndLoop) {
+            // Inner loops end first, so emptied inner loops are already gone here
+            int j = i - 1;
+            while (j > instruction->target && program->code[j].op == OpNop) {
+                j--;
+            }
+            if (j == instruction->target) {
+                program->code[j].op = OpNop;
+                instruction->op = OpNop;
+            }
+        }
+    }
+    remove_nops(program);
+}
+
+// Function to fold constant arithmetic, propagating integer constants through straight-line code
+void fold_constants(Program* program) {
+    bool known[MAX_VARIABLES] = {false};
+    int values[MAX_VARIABLES];
+
+    for (int i = 0; i < program->count; i++) {
+        Instruction* instruction = &program->code[i];
+        Operand* operands[2] = {&instruction->a, &instruction->b};
+
+        if (instruction->op == OpLoop) {
+            // Values assigned in the body differ between iterations; every loop here runs at
+            // least once, so whatever is still known at OpEndLoop also holds after the loop
+            VarSet assigned;
+            collect_assigned(program, i + 1, instruction->target, &assigned);
+            for (int slot = 0; slot < var_count; slot++) {
+                if (varset_has(&assigned, slot)) {
+                    known[slot] = false;
+                }
+            }
+            continue;
+        }
+        if (instruction->op == OpRead || instruction->op == OpTextAssign) {
+            known[instruction->dst] = false; // Text values are not tracked
+            continue;
+        }
+        if (instruction->op != OpAssign && instruction->op != OpTextFromInt && instruction->op != OpWrite) {
+            continue;
+        }
+
+        for (int k = 0; k < 2; k++) {
+            if (operands[k]->kind == VarOperand && known[operands[k]->value]) {
+                operands[k]->kind = ConstOperand;
+                operands[k]->value = values[operands[k]->value];
+            }
+        }
+        if (instruction->op == OpWrite) {
+            continue;
+        }
+
+        if (instruction->arith != '\0' && instruction->a.kind == ConstOperand && instruction->b.kind == ConstOperand) {
+            long long result = apply_arith(instruction->arith, instruction->a.value, instruction->b.value);
+            if (result < 0) result = 0; // Negative results are clamped to zero, as at runtime
+            if (result <= MAX_INTEGER_VALUE) {
+                instruction->arith = '\0';
+                instruction->a.value = (int)result;
+                instruction->b.kind = NoOperand;
+            }
+            // Out-of-range results stay unfolded so the error is still raised when reached
+        }
+
+        int dst = instruction->dst;
+        known[dst] = instruction->op == OpAssign && instruction->arith == '\0' && instruction->a.kind == ConstOperand;
+        values[dst] = instruction->a.value;
+    }
+}
+
+// Function to move loop-invariant assignments in front of their loop; returns true if anything moved
+bool hoist_loop_invariants(Program* program) {
+    ArenaMark mark = arena_mark(&arena);
+    int* owner = (int*)arena_alloc(&arena, program->count * sizeof(int), ScratchMemory);
+    bool changed = false;
+
+    for (int i = 0; i < program->count; i++) {
+        owner[i] = -1;
+    }
+
+    for (int l = 0; l < program->count; l++) {
+        if (program->code[l].op != OpLoop) {
+            continue;
+        }
+        int end = program->code[l].target;
+        VarSet assigned;
+        VarSet used_before;
+        int assign_counts[MAX_VARIABLES] = {0};
+        collect_assigned(program, l + 1, end, &assigned);
+        varset_clear(&used_before);
+        for (int k = l + 1; k < end; k++) {
+            if (writes_variable(program->code[k].op)) {
+                assign_counts[program->code[k].dst]++;
+            }
+        }
+
+        bool blocked = false; // Set once the body has done I/O or may have failed
+        int depth = 0;
+        for (int k = l + 1; k < end; k++) {
+            Instruction* instruction = &program->code[k];
+            bool may_fail = instruction_may_fail(instruction);
+
+            if (is_assignment(instruction->op) && depth == 0 &&
+                assign_counts[instruction->dst] == 1 &&
+                !varset_has(&used_before, instruction->dst) &&
+                !(instruction->a.kind == VarOperand && varset_has(&assigned, instruction->a.value)) &&
+                !(instruction->b.kind == VarOperand && varset_has(&assigned, instruction->b.value)) &&
+                (!may_fail || !blocked)) {
+                // A failing assignment may only move if nothing observable ran before it
+                owner[k] = l;
+                changed = true;
+                continue;
+            }
+
+            varset_add_operand(&used_before, instruction->a);
+            varset_add_operand(&used_before, instruction->b);
+            if (may_fail || instruction_does_io(instruction)) {
+                blocked = true;
+            }
+            if (instruction->op == OpLoop) {
+                depth++;
+            } else if (instruction->op == OpEndLoop) {
+                depth--;
+            }
+        }
+    }
+
+    if (changed) {
+        // Hoisting only reorders instructions, so the new order is built aside and copied back
+        Instruction* code = (Instruction*)arena_alloc(&arena, program->count * sizeof(Instruction), ScratchMemory);
+        int count = 0;
+        for (int i = 0; i < program->count; i++) {
+            if (owner[i] != -1) {
+                continue;
+            }
+            if (program->code[i].op == OpLoop) {
+                for (int k = i + 1; k < program->code[i].target; k++) {
+                    if (owner[k] == i) {
+                        code[count++] = program->code[k];
+                    }
+                }
+            }
+            code[count++] = program->code[i];
+        }
+        memcpy(program->code, code, count * sizeof(Instruction));
+        link_loops(program);
+    }
+
+    arena_release(&arena, mark);
+    return changed;
+}
+
+// Function to apply an instruction to the set of variables live after it, giving the set live
+// before it. Returns false for a dead store, which neither writes nor reads anything.
+bool transfer_liveness(const Instruction* instruction, VarSet* live) {
+    switch (instruction->op) {
+        case OpAssign:
+        case OpTextAssign:
+        case OpTextFromInt:
+            if (!varset_has(live, instruction->dst) && !instruction_may_fail(instruction)) {
+                return false;
+            }
+            varset_remove(live, instruction->dst);
+            varset_add_operand(live, instruction->a);
+            varset_add_operand(live, instruction->b);
+            break;
+        case OpRead:
+            varset_remove(live, instruction->dst);
+            break;
+        case OpWrite:
+            varset_add_operand(live, instruction->a);
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+// Function to get the variables live after instruction i: OpEndLoop flows both out of the loop
+// and back to the start of its body, and every remaining loop runs at least once
+VarSet live_after(const Program* program, const VarSet* live_in, int i, const VarSet* exit_live) {
+    const Instruction* instruction = &program->code[i];
+    if (instruction->op == OpHalt || i + 1 == program->count) {
+        return *exit_live;
+    }
+    VarSet live = live_in[i + 1];
+    if (instruction->op == OpEndLoop) {
+        for (int w = 0; w < VARSET_WORDS; w++) {
+            live.bits[w] |= live_in[instruction->target + 1].bits[w];
+        }
+    }
+    return live;
+}
+
+// Function to remove assignments whose value is overwritten or never read. Liveness is computed
+// once over the whole instruction list, with backward passes until no live set changes; each
+// pass carries liveness one loop level further along the back edges.
+void eliminate_dead_stores(Program* program) {
+    ArenaMark mark = arena_mark(&arena);
+    VarSet* live_in = (VarSet*)arena_alloc(&arena, program->count * sizeof(VarSet), ScratchMemory);
+    memset(live_in, 0, program->count * sizeof(VarSet));
+
+    VarSet exit_live;
+    varset_clear(&exit_live); // Nothing is read after the program halts
+    if (stream_source) {
+        // A streamed statement is followed by the rest of the file, which may read any variable
+        for (int slot = 0; slot < var_count; slot++) {
+            varset_add(&exit_live, slot);
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = program->count - 1; i >= 0; i--) {
+            VarSet live = live_after(program, live_in, i, &exit_live);
+            transfer_liveness(&program->code[i], &live);
+            if (memcmp(&live, &live_in[i], sizeof(VarSet)) != 0) {
+                live_in[i] = live;
+                changed = true;
+            }
+        }
+    }
+
+    for (int i = 0; i < program->count; i++) {
+        VarSet live = live_after(program, live_in, i, &exit_live);
+        if (!transfer_liveness(&program->code[i], &live)) {
+            program->code[i].op = OpNop;
+        }
+    }
+
+    arena_release(&arena, mark);
+    remove_nops(program);
+}
+
+// Function to run the optimization passes over a compiled program
+void optimize_program(Program* program) {
+    remove_dead_loops(program);
+    do {
+        fold_constants(program);
+    } while (hoist_loop_invariants(program));
+    eliminate_dead_stores(program);
+    remove_dead_loops(program);
+    summarize_loops(program);
+    plan_parallel_loops(program);
+    select_superinstructions(program);
+}
+
+// Function to check whether an assignment adds a constant to its own integer variable
+bool is_add_const(const Instruction* instruction) {
+    return instruction->op == OpAssign && instruction->arith == '+' &&
+           ((instruction->a.kind == VarOperand && instruction->a.value == instruction->dst && instruction->b.kind == ConstOperand) ||
+            (instruction->b.kind == VarOperand && instruction->b.value == instruction->dst && instruction->a.kind == ConstOperand));
+}
+
+// Function to replace common instruction sequences with fused superinstructions
+void select_superinstructions(Program* program) {
+    int count = 0;
+    for (int i = 0; i < program->count; i++) {
+        Instruction instruction = program->code[i];
+        bool has_next = i + 1 < program->count;
+
+        if (is_add_const(&instruction)) {
+            Operand step = instruction.a.kind == ConstOperand ? instruction.a : instruction.b;
+            instruction.a = step;
+            instruction.b.kind = NoOperand;
+            instruction.op = OpAddConst;
+            if (has_next && program->code[i + 1].op == OpEndLoop) {
+                instruction.op = OpAddConstEndLoop;
+                i++;
+            }
+        } else if (instruction.op == OpAssign && instruction.arith == '+' &&
+                   instruction.a.kind == VarOperand && instruction.b.kind == VarOperand) {
+            instruction.op = OpAddVars;
+        } else if (instruction.op == OpWrite && has_next && program->code[i + 1].op == OpNewLine) {
+            instruction.op = OpWriteLine;
+            i++;
+        }
+        program->code[count++] = instruction;
+    }
+    program->count = count;
+    link_loops(program);
+}
+
+// Function to find the update of a variable in a loop summary
+const VarUpdate* find_update(const LoopSummary* summary, int slot) {
+    for (int i = 0; i < summary->count; i++) {
+        if (summary->updates[i].dst == slot) {
+            return &summary->updates[i];
+        }
+    }
+    return NULL;
+}
+
+// Function to build the closed-form summary of a loop body, or return NULL if the body
+// does anything other than integer assignments with at most one update per variable
+LoopSummary* summarize_loop(const Program* program, int loop_index) {
+    int end = program->code[loop_index].target;
+    VarSet assigned;
+    collect_assigned(program, loop_index + 1, end, &assigned);
+
+    for (int i = loop_index + 1; i < end; i++) {
+        const Instruction* instruction = &program->code[i];
+        if (instruction->op != OpAssign) {
+            return NULL;
+        }
+    }
+
+    ArenaMark mark = arena_mark(&arena);
+    LoopSummary* summary = (LoopSummary*)arena_alloc(&arena, sizeof(LoopSummary), CodeMemory);
+    VarUpdate* updates = (VarUpdate*)arena_alloc(&arena, (end - loop_index) * sizeof(VarUpdate), CodeMemory);
+    summary->updates = updates;
+    summary->count = 0;
+    bool complete = true;
+
+    for (int i = loop_index + 1; complete && i < end; i++) {
+        const Instruction* instruction = &program->code[i];
+        int dst = instruction->dst;
+        Operand a = instruction->a;
+        Operand b = instruction->b;
+        if (instruction->arith == '+' && b.kind == VarOperand && b.value == dst) {
+            b = a; // v is x + v
+            a = instruction->b;
+        }
+        bool a_invariant = a.kind != VarOperand || !varset_has(&assigned, a.value);
+        bool b_invariant = b.kind != VarOperand || !varset_has(&assigned, b.value);
+        bool self_update = a.kind == VarOperand && a.value == dst;
+        VarUpdate update = {SetUpdate, dst, instruction->arith, a, b, {NoOperand, 0}, false};
+
+        if (find_update(summary, dst) != NULL) {
+            complete = false; // Assigned twice
+        } else if (a_invariant && (instruction->arith == '\0' || b_invariant)) {
+            update.kind = SetUpdate;
+        } else if (self_update && b_invariant && (instruction->arith == '+' || instruction->arith == '-')) {
+            update.kind = instruction->arith == '+' ? AddUpdate : SubtractUpdate;
+            update.step = b;
+        } else if (self_update && instruction->arith == '+' && b.value != dst) {
+            // Checked below, once every induction variable of the body is known
+            update.kind = AddInductionUpdate;
+            update.step = b;
+            update.after_induction = find_update(summary, b.value) != NULL;
+        } else {
+            complete = false;
+        }
+        summary->updates[summary->count++] = update;
+    }
+
+    for (int i = 0; complete && i < summary->count; i++) {
+        if (summary->updates[i].kind == AddInductionUpdate) {
+            const VarUpdate* induction = find_update(summary, summary->updates[i].step.value);
+            complete = induction != NULL && induction->kind == AddUpdate;
+        }
+    }
+    if (!complete) {
+        arena_release(&arena, mark);
+        return NULL;
+    }
+    return summary;
+}
+
+// Function to attach closed-form summaries to loops whose effect can be computed without iterating
+void summarize_loops(Program* program) {
+    for (int i = 0; i < program->count; i++) {
+        if (program->code[i].op == OpLoop && program->code[i].summary == NULL) {
+            program->code[i].summary = summarize_loop(program, i);
+        }
+    }
+}
+
+// Function to decide how the iterations of a loop can be split across threads. Each variable
+// the body writes must be an induction variable (one top-level v is v + step, with an invariant
+// step), a reduction (only ever updated as v is v + x and not read otherwise) or private to an
+// iteration (written at the top level of the body before any read). Returns NULL for loops that
+// read input, have a closed form, carry other values between iterations, or are too small.
+ParallelPlan* plan_parallel_loop(const Program* program, int loop_index) {
+    const Instruction* loop = &program->code[loop_index];
+    int end = loop->target;
+    if (loop->summary != NULL || loop->a.value < 2) {
+        return NULL;
+    }
+
+    enum { Unseen, ReadFirst, WrittenFirst } first_use[MAX_VARIABLES] = {Unseen};
+    int writes[MAX_VARIABLES] = {0};
+    int self_adds[MAX_VARIABLES] = {0};
+    int reads[MAX_VARIABLES] = {0};
+    Operand steps[MAX_VARIABLES];
+    bool top_level_add[MAX_VARIABLES] = {false};
+    long long multipliers[MAX_LOOP_DEPTH + 1] = {1};
+    long long work = 0;
+    int depth = 0;
+
+    for (int k = loop_index + 1; k < end; k++) {
+        const Instruction* instruction = &program->code[k];
+        work += multipliers[depth];
+        if (instruction->op == OpRead) {
+            return NULL;
+        }
+        if (instruction->op == OpLoop) {
+            depth++;
+            multipliers[depth] = multipliers[depth - 1] * instruction->a.value;
+            if (multipliers[depth] > PARALLEL_MIN_WORK) {
+                multipliers[depth] = PARALLEL_MIN_WORK; // Enough to decide, and cannot overflow
+            }
+            continue;
+        }
+        if (instruction->op == OpEndLoop) {
+            depth--;
+            continue;
+        }
+
+        int dst = writes_variable(instruction->op) ? instruction->dst : -1;
+        bool self_add = instruction->op == OpAssign && instruction->arith == '+' &&
+                        ((instruction->a.kind == VarOperand && instruction->a.value == dst) !=
+                         (instruction->b.kind == VarOperand && instruction->b.value == dst));
+        Operand operands[2] = {instruction->a, instruction->b};
+        for (int i = 0; i < 2; i++) {
+            if (operands[i].kind != VarOperand) {
+                continue;
+            }
+            if (first_use[operands[i].value] == Unseen) {
+                first_use[operands[i].value] = ReadFirst;
+            }
+            if (self_add && operands[i].value == dst) {
+                steps[dst] = operands[1 - i]; // The other operand is what gets added
+            } else {
+                reads[operands[i].value]++;
+            }
+        }
+        if (dst != -1) {
+            if (first_use[dst] == Unseen) {
+                first_use[dst] = depth == 0 ? WrittenFirst : ReadFirst;
+            }
+            writes[dst]++;
+            self_adds[dst] += self_add;
+            top_level_add[dst] = self_add && depth == 0;
+        }
+    }
+    if (work * loop->a.value < PARALLEL_MIN_WORK) {
+        return NULL;
+    }
+
+    ArenaMark mark = arena_mark(&arena);
+    ParallelPlan* plan = (ParallelPlan*)arena_alloc(&arena, sizeof(ParallelPlan), CodeMemory);
+    for (int slot = 0; slot < var_count; slot++) {
+        plan->roles[slot] = SharedVar;
+        if (writes[slot] == 0) {
+            continue;
+        }
+        bool invariant_step = writes[slot] == 1 && top_level_add[slot] &&
+                              (steps[slot].kind == ConstOperand || writes[steps[slot].value] == 0);
+        if (invariant_step) {
+            plan->roles[slot] = InductionVar;
+            plan->steps[slot] = steps[slot];
+        } else if (self_adds[slot] == writes[slot] && reads[slot] == 0) {
+            plan->roles[slot] = ReductionVar;
+        } else if (first_use[slot] == WrittenFirst) {
+            plan->roles[slot] = PrivateVar;
+        } else {
+            arena_release(&arena, mark);
+            return NULL;
+        }
+    }
+    return plan;
+}
+
+// Function to attach parallel execution plans to loops whose iterations are independent
+void plan_parallel_loops(Program* program) {
+    for (int i = 0; i < program->count; i++) {
+        if (program->code[i].op == OpLoop) {
+            program->code[i].parallel = plan_parallel_loop(program, i);
+        }
+    }
+}
+
+// Function to print an operand for the program dump
+void dump_operand(const Program* program, Operand operand) {
+    switch (operand.kind) {
+        case ConstOperand: fprintf(stderr, "%d", operand.value); break;
+        case VarOperand: fprintf(stderr, "%s", variables[operand.value].name); break;
+        case TextOperand: fprintf(stderr, "\"%s\"", program->texts[operand.value]); break;
+        default: break;
+    }
+}
+
+// Function to print the compiled program to stderr
+void dump_program(const Program* program, const char* title) {
+    fprintf(stderr, "; %s (%d instructions)\n", title, program->count);
+    int depth = 0;
+    for (int i = 0; i < program->count; i++) {
+        const Instruction* instruction = &program->code[i];
+        if (instruction->op == OpEndLoop) depth--;
+        fprintf(stderr, "%4d  %*s", i, depth * 2, "");
+        switch (instruction->op) {
+            case OpAssign:
+            case OpTextAssign:
+            case OpTextFromInt:
+            case OpAddVars:
+                fprintf(stderr, "%s is ", variables[instruction->dst].name);
+                dump_operand(program, instruction->a);
+                if (instruction->arith != '\0') {
+                    fprintf(stderr, " %c ", instruction->arith);
+                    dump_operand(program, instruction->b);
+                }
+                break;
+            case OpRead:
+                fprintf(stderr, "read ");
+                if (instruction->a.kind != NoOperand) {
+                    dump_operand(program, instruction->a);
+                    fprintf(stderr, " ");
+                }
+                fprintf(stderr, "%s", variables[instruction->dst].name);
+                break;
+            case OpWrite:
+            case OpWriteLine:
+                fprintf(stderr, "write ");
+                dump_operand(program, instruction->a);
+                if (instruction->op == OpWriteLine) {
+                    fprintf(stderr, ", newLine");
+                }
+                break;
+            case OpAddConst:
+            case OpAddConstEndLoop:
+                fprintf(stderr, "%s is %s + %d", variables[instruction->dst].name,
+                        variables[instruction->dst].name, instruction->a.value);
+                if (instruction->op == OpAddConstEndLoop) {
+                    fprintf(stderr, "; end -> %d", instruction->target);
+                }
+                break;
+            case OpNewLine: fprintf(stderr, "newLine"); break;
+            case OpLoop:
+                fprintf(stderr, "loop %d times -> %d%s%s", instruction->a.value, instruction->target,
+                        instruction->summary != NULL ? " (closed form)" : "",
+                        instruction->parallel != NULL ? " (parallel)" : "");
+                break;
+            case OpEndLoop: fprintf(stderr, "end -> %d", instruction->target); break;
+            case OpNop: fprintf(stderr, "nop"); break;
+            case OpHalt: fprintf(stderr, "halt"); break;
+        }
+        fprintf(stderr, "\n");
+        if (instruction->op == OpLoop) depth++;
+        if (instruction->op == OpAddConstEndLoop) depth--;
+    }
+}
+
+// Function to read an integer operand at runtime; the analyzer guarantees variables are integers
+long long integer_operand(const Machine* machine, Operand operand) {
+    return operand.kind == ConstOperand ? operand.value : machine->vars[operand.value].value.intValue;
+}
+
+// Function to read a text operand at runtime; the analyzer guarantees variables are text
+const char* text_operand(const Program* program, const Machine* machine, Operand operand, int* length) {
+    if (operand.kind == TextOperand) {
+        *length = program->text_lengths[operand.value];
+        return program->texts[operand.value];
+    }
+    *length = machine->vars[operand.value].length;
+    return machine->vars[operand.value].value.strValue;
+}
+
+// Function to report an integer result above the language limit
+void integer_overflow(const Machine* machine, const Variable* var) {
+    if (machine->abort != NULL) {
+        longjmp(*machine->abort, 1);
+    }
+    fprintf(stderr, "Runtime error: Integer value exceeds %d for variable %s\n", MAX_INTEGER_VALUE, var->name);
+    exit(EXIT_FAILURE);
+}
+
+// Function to evaluate the integer expression of an assignment, clamped and range checked
+int evaluate_integer(const Machine* machine, const Instruction* instruction) {
+    long long result = integer_operand(machine, instruction->a);
+    if (instruction->arith != '\0') {
+        result = apply_arith(instruction->arith, result, integer_operand(machine, instruction->b));
+    }
+    if (result < 0) result = 0;
+    if (result > MAX_INTEGER_VALUE) {
+        integer_overflow(machine, &machine->vars[instruction->dst]);
+    }
+    return (int)result;
+}
+
+// Function to find the first occurrence of a non-empty needle: memchr skips ahead to the next
+// candidate first character, and only candidates are compared in full. Returns -1 if there is none
+int find_text(const char* haystack, int length, const char* needle, int needle_length) {
+    int last = length - needle_length;
+    int offset = 0;
+    while (offset <= last) {
+        const char* candidate = (const char*)memchr(haystack + offset, needle[0], last - offset + 1);
+        if (candidate == NULL) {
+            return -1;
+        }
+        offset = (int)(candidate - haystack);
+        if (memcmp(candidate + 1, needle + 1, needle_length - 1) == 0) {
+            return offset;
+        }
+        offset++;
+    }
+    return -1;
+}
+
+// Function to execute a text assignment directly into the destination: s is s + x only appends x,
+// and s is s - x only moves the characters behind the removed occurrence. Results are truncated
+// to MAX_STRING_LENGTH - 1 characters.
+void execute_text_assign(const Program* program, Machine* machine, const Instruction* instruction) {
+    Variable* var = &machine->vars[instruction->dst];
+    char* dst = var->value.strValue;
+    int a_length;
+    int b_length;
+    const char* a = text_operand(program, machine, instruction->a, &a_length);
+
+    if (instruction->arith == '+') {
+        const char* b = text_operand(program, machine, instruction->b, &b_length);
+        if (b_length > MAX_STRING_LENGTH - 1 - a_length) {
+            b_length = MAX_STRING_LENGTH - 1 - a_length;
+        }
+        if (b == dst && a != dst) {
+            // x + s: move s behind x
+            memmove(dst + a_length, dst, b_length);
+            memcpy(dst, a, a_length);
+        } else {
+            if (a != dst) {
+                memcpy(dst, a, a_length);
+            }
+            memcpy(dst + a_length, b, b_length);
+        }
+        var->length = a_length + b_length;
+    } else if (instruction->arith == '-') {
+        const char* b = text_operand(program, machine, instruction->b, &b_length);
+        int found = b_length > 0 ? find_text(a, a_length, b, b_length) : -1;
+        if (found < 0) {
+            if (a != dst) {
+                memcpy(dst, a, a_length);
+            }
+            var->length = a_length;
+        } else {
+            if (a != dst) {
+                memcpy(dst, a, found);
+            }
+            memmove(dst + found, a + found + b_length, a_length - found - b_length);
+            var->length = a_length - b_length;
+        }
+    } else {
+        if (a != dst) {
+            memcpy(dst, a, a_length);
+        }
+        var->length = a_length;
+    }
+    dst[var->length] = '\0';
+}
+
+// Function to print the prompt of a read instruction
+void prompt_read(const Program* program, Machine* machine, const Instruction* instruction) {
+    const Variable* var = &machine->vars[instruction->dst];
+    if (instruction->a.kind == TextOperand) {
+        fprintf(machine->output, "%s", program->texts[instruction->a.value]);
+    } else {
+        fprintf(machine->output, "Enter %s value for %s: ", var->type == Integer ? "integer" : "string", var->name);
+    }
+    fflush(machine->output);
+}
+
+// Function to wait until standard input can be read. Returns false when a checkpoint is requested
+// first. Only waits when checkpoints are enabled, which leaves standard input unbuffered, so that
+// no input can be waiting in its buffer while the descriptor has none.
+bool wait_for_input(void) {
+    if (checkpoint_pipe[0] < 0) {
+        return true;
+    }
+    struct pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {checkpoint_pipe[0], POLLIN, 0}};
+    while (!checkpoint_pending) {
+        if (poll(fds, 2, -1) < 0 && errno != EINTR) {
+            perror("Error waiting for input");
+            exit(EXIT_FAILURE);
+        }
+        if (fds[0].revents != 0) {
+            return true;
+        }
+        char drained[64];
+        while (read(checkpoint_pipe[0], drained, sizeof(drained)) > 0) {
+            // Wake-ups are only counted through checkpoint_pending
+        }
+    }
+    return false;
+}
+
+// Function to execute a read instruction, after its prompt. Returns false without changing the
+// variable when a checkpoint was requested while it waited for input.
+bool execute_read(Machine* machine, const Instruction* instruction) {
+    Variable* var = &machine->vars[instruction->dst];
+    if (!wait_for_input()) {
+        return false;
+    }
+
+    if (var->type == Integer) {
+        long long value;
+        if (scanf("%lld", &value) != 1) {
+            fprintf(stderr, "Warning: Invalid input, 0 assigned to %s.\n", var->name);
+            value = 0;
+            int ch;
+            while ((ch = getchar()) != '\n' && ch != EOF) {
+                // Discard the rest of the invalid line
+            }
+        }
+        if (value < 0) value = 0;
+        if (value > MAX_INTEGER_VALUE) {
+            integer_overflow(machine, var);
+        }
+        var->value.intValue = (int)value;
+    } else {
+        char value[MAX_STRING_LENGTH];
+        if (scanf("%255s", value) != 1) {
+            value[0] = '\0';
+        }
+        strcpy(var->value.strValue, value);
+        var->length = (int)strlen(value);
+    }
+    return true;
+}
+
+// Function to apply the effect of running a summarized loop a number of times. Returns false
+// without changing any variable when some update would exceed the integer limit, so that the
+// caller can iterate and report the error exactly where the loop would have hit it.
+bool apply_loop_summary(Machine* machine, const LoopSummary* summary, long long iterations) {
+    long long results[MAX_VARIABLES];
+
+    // Integers are non-negative, so every updated value moves monotonically: clamping at zero
+    // after each step equals clamping the total, and the final value is the largest one reached.
+    // Products of two in-range values cannot overflow a long long.
+    for (int i = 0; i < summary->count; i++) {
+        const VarUpdate* update = &summary->updates[i];
+        long long start = machine->vars[update->dst].value.intValue;
+        long long result = 0;
+
+        switch (update->kind) {
+            case SetUpdate:
+                result = integer_operand(machine, update->a);
+                if (update->arith != '\0') {
+                    result = apply_arith(update->arith, result, integer_operand(machine, update->b));
+                }
+                break;
+            case AddUpdate:
+                result = start + iterations * integer_operand(machine, update->step);
+                break;
+            case SubtractUpdate:
+                result = start - iterations * integer_operand(machine, update->step);
+                break;
+            case AddInductionUpdate: {
+                // Iteration t adds w0 + (t + 1) * d when w is updated first, w0 + t * d otherwise
+                const VarUpdate* induction = find_update(summary, update->step.value);
+                long long w0 = machine->vars[update->step.value].value.intValue;
+                long long d = integer_operand(machine, induction->step);
+                long long steps = iterations * (iterations - 1) / 2 + (update->after_induction ? iterations : 0);
+                if (d != 0 && steps > MAX_INTEGER_VALUE / d) {
+                    return false;
+                }
+                result = start + iterations * w0 + steps * d;
+                break;
+            }
+        }
+        if (result < 0) result = 0;
+        if (result > MAX_INTEGER_VALUE) {
+            return false;
+        }
+        results[i] = result;
+    }
+
+    for (int i = 0; i < summary->count; i++) {
+        machine->vars[summary->updates[i].dst].value.intValue = (int)results[i];
+    }
+    return true;
+}
+
+// Function to print an operand of a write instruction
+void write_operand(const Program* program, const Machine* machine, Operand operand) {
+    if (operand.kind == TextOperand) {
+        fputs(program->texts[operand.value], machine->output);
+    } else if (operand.kind == ConstOperand) {
+        fprintf(machine->output, "%d", operand.value);
+    } else if (machine->vars[operand.value].type == Integer) {
+        fprintf(machine->output, "%d", machine->vars[operand.value].value.intValue);
+    } else {
+        fwrite(machine->vars[operand.value].value.strValue, 1, machine->vars[operand.value].length, machine->output);
+    }
+}
+
+// Function to run one chunk of a parallel loop on its own variables and output buffer
+void run_chunk(ParallelChunk* chunk) {
+    if (chunk->failed) {
+        return; // Set up to fail: an earlier chunk overflows before this one starts
+    }
+    jmp_buf abort;
+    Machine machine = {chunk->vars, open_memstream(&chunk->output, &chunk->output_size), &abort};
+    if (machine.output == NULL) {
+        chunk->failed = true;
+        return;
+    }
+    if (setjmp(abort) == 0) {
+        run_program(&chunk->code, &machine);
+    } else {
+        chunk->failed = true; // The serial rerun reports the error
+    }
+    fclose(machine.output);
+}
+
+// Function run by each pool thread: take chunks of the current loop until none are left
+void* pool_worker(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&pool.lock);
+    while (true) {
+        while (pool.next_chunk >= pool.chunk_count) {
+            pthread_cond_wait(&pool.work_ready, &pool.lock);
+        }
+        ParallelChunk* chunk = &pool.chunks[pool.next_chunk++];
+        pthread_mutex_unlock(&pool.lock);
+        run_chunk(chunk);
+        pthread_mutex_lock(&pool.lock);
+        if (++pool.finished_chunks == pool.chunk_count) {
+            pthread_cond_signal(&pool.work_done);
+        }
+    }
+    return NULL;
+}
+
+// Function to run all chunks on the thread pool, with the calling thread taking part
+void run_chunks(ParallelChunk* chunks, int count) {
+    pthread_mutex_lock(&pool.lock);
+    while (pool.thread_count < thread_count - 1) {
+        if (pthread_create(&pool.threads[pool.thread_count], NULL, pool_worker, NULL) != 0) {
+            break; // Run with the threads we have
+        }
+        pool.thread_count++;
+    }
+    pool.chunks = chunks;
+    pool.chunk_count = count;
+    pool.next_chunk = 0;
+    pool.finished_chunks = 0;
+    pthread_cond_broadcast(&pool.work_ready);
+
+    while (pool.next_chunk < pool.chunk_count) {
+        ParallelChunk* chunk = &pool.chunks[pool.next_chunk++];
+        pthread_mutex_unlock(&pool.lock);
+        run_chunk(chunk);
+        pthread_mutex_lock(&pool.lock);
+        pool.finished_chunks++;
+    }
+    while (pool.finished_chunks < pool.chunk_count) {
+        pthread_cond_wait(&pool.work_done, &pool.lock);
+    }
+    pool.chunk_count = 0;
+    pool.next_chunk = 0;
+    pthread_mutex_unlock(&pool.lock);
+}
+
+// Function to run a planned loop across the thread pool, in rounds of at most
+// PARALLEL_ROUND_ITERATIONS iterations per thread, so that buffered output stays bounded and is
+// printed as the loop goes. A round in which a chunk hits a runtime error or a reduction exceeds
+// the integer limit has no visible effect. Returns the number of iterations not run; the caller
+// runs them serially, which reports the error with identical output. A checkpoint requested while
+// the loop runs is saved between two rounds, as if at the loop's back-edge.
+long long run_parallel_loop(const Program* program, Machine* machine, int loop_index, int depth, int* loop_counters) {
+    const Instruction* loop = &program->code[loop_index];
+    const ParallelPlan* plan = loop->parallel;
+    int end = loop->target;
+    int body_size = end - loop_index + 1;
+    long long remaining = loop->a.value;
+    int count = thread_count < remaining ? thread_count : (int)remaining;
+
+    ArenaMark mark = arena_mark(&arena);
+    ParallelChunk* chunks = (ParallelChunk*)arena_alloc(&arena, count * sizeof(ParallelChunk), ScratchMemory);
+    memset(chunks, 0, count * sizeof(ParallelChunk));
+    for (int c = 0; c < count; c++) {
+        // Each chunk runs a copy of the loop with its own iteration count
+        ParallelChunk* chunk = &chunks[c];
+        chunk->code.count = body_size + 1;
+        chunk->code.capacity = body_size + 1;
+        chunk->code.code = (Instruction*)arena_alloc(&arena, (body_size + 1) * sizeof(Instruction), ScratchMemory);
+        chunk->code.texts = program->texts;
+        chunk->code.text_lengths = program->text_lengths;
+        chunk->code.origin = loop_index;
+        chunk->code.text_count = program->text_count;
+        chunk->vars = (Variable*)arena_alloc(&arena, var_count * sizeof(Variable), ScratchMemory);
+        memcpy(chunk->code.code, &program->code[loop_index], body_size * sizeof(Instruction));
+        chunk->code.code[0].parallel = NULL;
+        chunk->code.code[body_size].op = OpHalt;
+        link_loops(&chunk->code);
+    }
+
+    while (remaining > 0) {
+        if (checkpoint_pending) {
+            loop_counters[depth] = (int)remaining;
+            save_checkpoint(program, machine, loop_index + 1, depth + 1, loop_counters);
+        }
+        long long round = (long long)count * PARALLEL_ROUND_ITERATIONS;
+        if (round > remaining) {
+            round = remaining;
+        }
+        int active = round < count ? (int)round : count;
+        long long first = 0;
+        for (int c = 0; c < active; c++) {
+            ParallelChunk* chunk = &chunks[c];
+            long long size = round / active + (c < round % active ? 1 : 0);
+            chunk->code.code[0].a.value = (int)size;
+            chunk->output = NULL;
+            chunk->output_size = 0;
+            chunk->failed = false;
+
+            memcpy(chunk->vars, machine->vars, var_count * sizeof(Variable));
+            for (int slot = 0; slot < var_count; slot++) {
+                if (plan->roles[slot] == InductionVar) {
+                    long long start = machine->vars[slot].value.intValue + first * integer_operand(machine, plan->steps[slot]);
+                    if (start > MAX_INTEGER_VALUE) {
+                        chunk->failed = true;
+                    }
+                    chunk->vars[slot].value.intValue = (int)start;
+                } else if (plan->roles[slot] == ReductionVar) {
+                    chunk->vars[slot].value.intValue = 0;
+                }
+            }
+            first += size;
+        }
+
+        run_chunks(chunks, active);
+
+        bool ok = true;
+        long long totals[MAX_VARIABLES];
+        for (int slot = 0; slot < var_count; slot++) {
+            totals[slot] = machine->vars[slot].value.intValue;
+        }
+        for (int c = 0; c < active; c++) {
+            ok = ok && !chunks[c].failed;
+            for (int slot = 0; slot < var_count; slot++) {
+                if (plan->roles[slot] == ReductionVar) {
+                    totals[slot] += chunks[c].vars[slot].value.intValue;
+                    ok = ok && totals[slot] <= MAX_INTEGER_VALUE;
+                }
+            }
+        }
+
+        if (ok) {
+            // Output in iteration order; induction and private variables end as the last chunk left them
+            for (int c = 0; c < active; c++) {
+                fwrite(chunks[c].output, 1, chunks[c].output_size, machine->output);
+            }
+            const Variable* last = chunks[active - 1].vars;
+            for (int slot = 0; slot < var_count; slot++) {
+                if (plan->roles[slot] == ReductionVar) {
+                    machine->vars[slot].value.intValue = (int)totals[slot];
+                } else if (plan->roles[slot] != SharedVar) {
+                    machine->vars[slot] = last[slot];
+                }
+            }
+            remaining -= round;
+        }
+
+        for (int c = 0; c < active; c++) {
+            free(chunks[c].output);
+        }
+        if (!ok) {
+            break;
+        }
+    }
+
+    arena_release(&arena, mark);
+    return remaining;
+}
+
+// Function to record a checkpoint request; the running program saves at its next loop iteration,
+// read or halt, and a read waiting for input is woken up. A second SIGTERM or SIGINT stops the
+// program at once.
+void request_checkpoint(int signal_number) {
+    int saved_errno = errno;
+    checkpoint_pending = 1;
+    if (signal_number == SIGTERM || signal_number == SIGINT) {
+        stop_after_checkpoint = 1;
+        signal(signal_number, SIG_DFL);
+    }
+    if (write(checkpoint_pipe[1], "", 1) < 0) {
+        // The pipe is full, so a wake-up is already pending
+    }
+    errno = saved_errno;
+}
+
+// Function to take checkpoints on SIGUSR1, before stopping on SIGTERM or SIGINT, and every
+// interval seconds when interval is positive. Interrupted system calls are restarted, so that
+// output being written is never lost; reads wait for input in wait_for_input instead.
+void install_checkpoint_handlers(int interval) {
+    if (pipe(checkpoint_pipe) != 0 || fcntl(checkpoint_pipe[0], F_SETFL, O_NONBLOCK) != 0 ||
+        fcntl(checkpoint_pipe[1], F_SETFL, O_NONBLOCK) != 0) {
+        perror("Error setting up checkpoints");
+        exit(EXIT_FAILURE);
+    }
+    setvbuf(stdin, NULL, _IONBF, 0);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = request_checkpoint;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGUSR1, &action, NULL);
+    sigaction(SIGALRM, &action, NULL);
+
+    if (interval > 0) {
+        struct itimerval timer = {{interval, 0}, {interval, 0}};
+        setitimer(ITIMER_REAL, &timer, NULL);
+    }
+}
+
+// Function to compute a fingerprint of the compiled program and its variables, so that a snapshot
+// is only restored into the program (and optimization level) that produced it
+uint64_t program_fingerprint(const Program* program, const Machine* machine) {
+    uint64_t hash = 14695981039346656037ULL; // FNV-1a
+    int fields[9];
+    for (int i = 0; i < program->count; i++) {
+        const Instruction* instruction = &program->code[i];
+        fields[0] = instruction->op;
+        fields[1] = instruction->arith;
+        fields[2] = instruction->dst;
+        fields[3] = instruction->a.kind;
+        fields[4] = instruction->a.value;
+        fields[5] = instruction->b.kind;
+        fields[6] = instruction->b.value;
+        fields[7] = instruction->target;
+        fields[8] = (instruction->summary != NULL) | (instruction->parallel != NULL) << 1;
+        for (size_t k = 0; k < sizeof(fields); k++) {
+            hash = (hash ^ ((unsigned char*)fields)[k]) * 1099511628211ULL;
+        }
+    }
+    for (int i = 0; i < program->text_count; i++) {
+        for (const char* c = program->texts[i]; ; c++) {
+            hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+            if (*c == '\0') break;
+        }
+    }
+    for (int slot = 0; slot < var_count; slot++) {
+        for (const char* c = machine->vars[slot].name; ; c++) {
+            hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+            if (*c == '\0') break;
+        }
+        hash = (hash ^ machine->vars[slot].type) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Functions to write snapshot fields in little-endian byte order
+unsigned char* put_u32(unsigned char* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        *out++ = (unsigned char)(value >> (8 * i));
+    }
+    return out;
+}
+
+unsigned char* put_u64(unsigned char* out, uint64_t value) {
+    out = put_u32(out, (uint32_t)value);
+    return put_u32(out, (uint32_t)(value >> 32));
+}
+
+// Function to save the state of a running program to the checkpoint file. The snapshot holds the
+// position to continue at, the counters of the active loops and all variables:
+//   "STAR", version, program fingerprint, pc, loop depth, loop counters, variable count,
+//   then per variable its type and either its integer value or its text length and characters
+// It is written to a temporary file and renamed, so a crash never leaves a partial snapshot.
+void save_checkpoint(const Program* program, const Machine* machine, int pc, int depth, const int* loop_counters) {
+    // Everything printed so far belongs to the run before the snapshot
+    if (fflush(machine->output) != 0 || ferror(machine->output)) {
+        perror("Checkpoint error: Output could not be written");
+        exit(EXIT_FAILURE);
+    }
+
+    ArenaMark mark = arena_mark(&arena);
+    size_t size = 4 + 4 + 8 + 4 + 4 + 4 * (size_t)depth + 4 + (size_t)var_count * (1 + 4 + MAX_STRING_LENGTH);
+    unsigned char* buffer = (unsigned char*)arena_alloc(&arena, size, ScratchMemory);
+    unsigned char* out = buffer;
+    memcpy(out, SNAPSHOT_MAGIC, 4);
+    out = put_u32(out + 4, SNAPSHOT_VERSION);
+    out = put_u64(out, program_fingerprint(program, machine));
+    out = put_u32(out, pc);
+    out = put_u32(out, depth);
+    for (int i = 0; i < depth; i++) {
+        out = put_u32(out, loop_counters[i]);
+    }
+    out = put_u32(out, var_count);
+    for (int slot = 0; slot < var_count; slot++) {
+        const Variable* var = &machine->vars[slot];
+        *out++ = (unsigned char)var->type;
+        if (var->type == Integer) {
+            out = put_u32(out, var->value.intValue);
+        } else {
+            out = put_u32(out, var->length);
+            memcpy(out, var->value.strValue, var->length);
+            out += var->length;
+        }
+    }
+
+    char temporary[4096];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", checkpoint_file);
+    FILE* file = fopen(temporary, "wb");
+    if (file == NULL || fwrite(buffer, 1, out - buffer, file) != (size_t)(out - buffer) ||
+        fflush(file) != 0 || fsync(fileno(file)) != 0 || fclose(file) != 0 || rename(temporary, checkpoint_file) != 0) {
+        perror("Checkpoint error");
+        exit(EXIT_FAILURE);
+    }
+    arena_release(&arena, mark);
+
+    checkpoint_pending = 0;
+    if (stop_after_checkpoint) {
+        fprintf(stderr, "Checkpoint saved to %s\n", checkpoint_file);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Function to read a 32-bit little-endian snapshot field
+uint32_t read_u32(const unsigned char* data, size_t size, size_t* offset) {
+    if (size - *offset < 4) {
+        fprintf(stderr, "Restore error: Snapshot is truncated\n");
+        exit(EXIT_FAILURE);
+    }
+    const unsigned char* in = data + *offset;
+    *offset += 4;
+    return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+// Function to restore the state saved by save_checkpoint into a machine about to run the program.
+// The snapshot is mapped into memory and decoded in place.
+void restore_checkpoint(const Program* program, Machine* machine, const char* filepath) {
+    int fd = open(filepath, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        perror("Error opening snapshot");
+        exit(EXIT_FAILURE);
+    }
+    size_t size = (size_t)info.st_size;
+    if (size < 8) {
+        fprintf(stderr, "Restore error: Snapshot is truncated\n");
+        exit(EXIT_FAILURE);
+    }
+    const unsigned char* data = (const unsigned char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Error mapping snapshot");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t offset = 4;
+    if (memcmp(data, SNAPSHOT_MAGIC, 4) != 0) {
+        fprintf(stderr, "Restore error: Not a STAR snapshot\n");
+        exit(EXIT_FAILURE);
+    }
+    uint32_t version = read_u32(data, size, &offset);
+    if (version != SNAPSHOT_VERSION) {
+        fprintf(stderr, "Restore error: Unsupported snapshot version %u\n", version);
+        exit(EXIT_FAILURE);
+    }
+    uint64_t fingerprint = read_u32(data, size, &offset);
+    fingerprint |= (uint64_t)read_u32(data, size, &offset) << 32;
+    if (fingerprint != program_fingerprint(program, machine)) {
+        fprintf(stderr, "Restore error: Snapshot was taken from a different program or optimization level\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // The fingerprint matches, so positions, loop nesting and variable types are those of this program
+    machine->pc = (int)read_u32(data, size, &offset);
+    machine->depth = (int)read_u32(data, size, &offset);
+    if (machine->pc < 0 || machine->pc >= program->count || machine->depth < 0 || machine->depth > MAX_LOOP_DEPTH) {
+        fprintf(stderr, "Restore error: Snapshot is corrupt\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < machine->depth; i++) {
+        machine->loop_counters[i] = (int)read_u32(data, size, &offset);
+    }
+    if ((int)read_u32(data, size, &offset) != var_count) {
+        fprintf(stderr, "Restore error: Snapshot is corrupt\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int slot = 0; slot < var_count; slot++) {
+        Variable* var = &machine->vars[slot];
+        if (offset >= size || data[offset++] != var->type) {
+            fprintf(stderr, "Restore error: Snapshot is corrupt\n");
+            exit(EXIT_FAILURE);
+        }
+        uint32_t value = read_u32(data, size, &offset);
+        if (var->type == Integer && value <= MAX_INTEGER_VALUE) {
+            var->value.intValue = (int)value;
+        } else if (var->type == Integer || value >= MAX_STRING_LENGTH || size - offset < value) {
+            fprintf(stderr, "Restore error: Snapshot is corrupt\n");
+            exit(EXIT_FAILURE);
+        } else {
+            memcpy(var->value.strValue, data + offset, value);
+            var->value.strValue[value] = '\0';
+            var->length = (int)value;
+            offset += value;
+        }
+    }
+    munmap((void*)data, size);
+}
+
+// Function to read a monotonic clock in nanoseconds
+unsigned long long monotonic_nanoseconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec;
+}
+
+// Function to append an unsigned LEB128 varint to a buffer
+unsigned char* put_varint(unsigned char* out, unsigned long long value) {
+    while (value >= 0x80) {
+        *out++ = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (unsigned char)value;
+    return out;
+}
+
+// Function to get the trace buffer of the calling thread, registering one on first use. Buffers
+// use malloc rather than the arena, since worker threads register them while the main thread
+// owns the arena.
+TraceBuffer* get_trace_buffer(void) {
+    if (thread_trace_buffer != NULL) {
+        return thread_trace_buffer;
+    }
+    TraceBuffer* buffer = (TraceBuffer*)malloc(sizeof(TraceBuffer));
+    unsigned long long* counts = (unsigned long long*)calloc(tracer.instruction_count, sizeof(unsigned long long));
+    unsigned long long* io_ticks = (unsigned long long*)calloc(tracer.instruction_count, sizeof(unsigned long long));
+    if (buffer == NULL || counts == NULL || io_ticks == NULL) {
+        perror("Memory allocation error");
+        exit(EXIT_FAILURE);
+    }
+    buffer->counts = counts;
+    buffer->io_ticks = io_ticks;
+    atomic_init(&buffer->head, 0);
+    atomic_init(&buffer->tail, 0);
+    buffer->limit = TRACE_BUFFER_SIZE;
+    buffer->last_clock = trace_clock();
+
+    pthread_mutex_lock(&tracer.lock);
+    int count = atomic_load_explicit(&tracer.buffer_count, memory_order_relaxed);
+    buffer->thread = count;
+    tracer.buffers[count] = buffer;
+    atomic_store_explicit(&tracer.buffer_count, count + 1, memory_order_release);
+    pthread_mutex_unlock(&tracer.lock);
+
+    thread_trace_buffer = buffer;
+    return buffer;
+}
+
+// Function to append an event to a trace buffer: the instruction index and event kind, the clock
+// ticks from the thread's previous event to time and, for a LoopExitEvent, value
+void trace_event(TraceBuffer* buffer, int pc, enum TraceEventKind kind, unsigned long long time, unsigned long long value) {
+    size_t head = atomic_load_explicit(&buffer->head, memory_order_relaxed);
+    if (head + TRACE_MAX_EVENT_SIZE > buffer->limit) {
+        // The cached end of the free space is too close: see how far the flusher has got
+        buffer->limit = atomic_load_explicit(&buffer->tail, memory_order_acquire) + TRACE_BUFFER_SIZE;
+        while (head + TRACE_MAX_EVENT_SIZE > buffer->limit) {
+            sched_yield(); // Full: wait for the flusher rather than lose events
+            buffer->limit = atomic_load_explicit(&buffer->tail, memory_order_acquire) + TRACE_BUFFER_SIZE;
+        }
+    }
+
+    // Events are encoded straight into the ring, unless they could wrap around its end
+    size_t start = head & (TRACE_BUFFER_SIZE - 1);
+    unsigned char event[TRACE_MAX_EVENT_SIZE];
+    unsigned char* base = start + TRACE_MAX_EVENT_SIZE <= TRACE_BUFFER_SIZE ? buffer->data + start : event;
+    unsigned char* out = put_varint(base, (unsigned long long)pc << 1 | kind);
+    out = put_varint(out, time - buffer->last_clock);
+    if (kind == LoopExitEvent) {
+        out = put_varint(out, value);
+    }
+    buffer->last_clock = time;
+
+    size_t size = out - base;
+    if (base == event) {
+        for (size_t i = 0; i < size; i++) {
+            buffer->data[(head + i) & (TRACE_BUFFER_SIZE - 1)] = event[i];
+        }
+    }
+    atomic_store_explicit(&buffer->head, head + size, memory_order_release);
+}
+
+// Function to record that the loop at loop_pc of a running program starts. The loop a parallel
+// chunk runs was already entered by the thread that split it, so chunks do not enter it again.
+void trace_loop_enter(TraceBuffer* buffer, const Program* program, const Machine* machine, int loop_pc) {
+    if (machine->abort == NULL || loop_pc != 0) {
+        trace_event(buffer, program->origin + loop_pc, LoopEnterEvent, trace_clock(), 0);
+    }
+}
+
+// Function to record that the loop at loop_pc of a running program has finished. Iterations that
+// ran count through the loop's end instruction; summarized is the number of iterations that
+// apply_loop_summary did at once instead.
+void trace_loop_exit(TraceBuffer* buffer, const Program* program, const Machine* machine, int loop_pc, long long summarized) {
+    if (machine->abort == NULL || loop_pc != 0) {
+        trace_event(buffer, program->origin + loop_pc, LoopExitEvent, trace_clock(), (unsigned long long)summarized);
+    }
+}
+
+// Function to write the events buffered by every thread to the trace file, one EventsRecord per
+// buffer: the thread number, the number of bytes and the encoded events. Returns false if there
+// was nothing to write.
+bool flush_trace_buffers(void) {
+    bool flushed = false;
+    int count = atomic_load_explicit(&tracer.buffer_count, memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        TraceBuffer* buffer = tracer.buffers[i];
+        size_t tail = atomic_load_explicit(&buffer->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&buffer->head, memory_order_acquire);
+        if (head == tail) {
+            continue;
+        }
+
+        unsigned char record[32];
+        unsigned char* out = record;
+        *out++ = EventsRecord;
+        out = put_varint(out, buffer->thread);
+        out = put_varint(out, head - tail);
+        fwrite(record, 1, out - record, tracer.file);
+
+        size_t start = tail & (TRACE_BUFFER_SIZE - 1);
+        size_t first = head - tail < TRACE_BUFFER_SIZE - start ? head - tail : TRACE_BUFFER_SIZE - start;
+        fwrite(buffer->data + start, 1, first, tracer.file);
+        fwrite(buffer->data, 1, head - tail - first, tracer.file);
+        atomic_store_explicit(&buffer->tail, head, memory_order_release);
+        flushed = true;
+    }
+    return flushed;
+}
+
+// Function run by the flusher thread: writes buffered events until the trace is stopped
+void* trace_flusher(void* arg) {
+    (void)arg;
+    struct timespec pause = {0, 1000000};
+    while (!atomic_load_explicit(&tracer.stop, memory_order_acquire)) {
+        if (!flush_trace_buffers()) {
+            nanosleep(&pause, NULL);
+        }
+    }
+    return NULL;
+}
+
+// Function to start tracing a program. The trace file begins with the source path and, for every
+// instruction, its class (compute, I/O, loop or loop control), source offset + 1 (0 if none) and,
+// for a loop, the index of its end, so that events only need to carry instruction indexes.
+void start_trace(const Program* program, const char* source_path) {
+    tracer.file = fopen(trace_path, "wb");
+    if (tracer.file == NULL) {
+        perror("Error opening trace file");
+        exit(EXIT_FAILURE);
+    }
+    tracer.instruction_count = program->count;
+
+    unsigned char header[32];
+    unsigned char* out = header;
+    memcpy(out, TRACE_MAGIC, 4);
+    out = put_u32(out + 4, TRACE_VERSION);
+    out = put_varint(out, strlen(source_path));
+    fwrite(header, 1, out - header, tracer.file);
+    fwrite(source_path, 1, strlen(source_path), tracer.file);
+    out = put_varint(header, program->count);
+    fwrite(header, 1, out - header, tracer.file);
+    for (int i = 0; i < program->count; i++) {
+        enum OpCode op = program->code[i].op;
+        out = header;
+        if (op == OpLoop) {
+            *out++ = LoopClass;
+        } else if (op == OpEndLoop || op == OpNop || op == OpHalt) {
+            *out++ = ControlClass;
+        } else if (instruction_does_io(&program->code[i])) {
+            *out++ = IoClass;
+        } else {
+            *out++ = ComputeClass;
+        }
+        out = put_varint(out, program->code[i].source + 1);
+        if (op == OpLoop) {
+            out = put_varint(out, program->code[i].target);
+        }
+        fwrite(header, 1, out - header, tracer.file);
+    }
+
+    // Every timed I/O instruction also measures one clock read, which is taken off its time
+    tracer.clock_cost = ~0ULL;
+    for (int i = 0; i < 100; i++) {
+        unsigned long long before = trace_clock();
+        unsigned long long cost = trace_clock() - before;
+        if (cost < tracer.clock_cost) {
+            tracer.clock_cost = cost;
+        }
+    }
+
+    tracer.start_clock = trace_clock();
+    tracer.start_time = monotonic_nanoseconds();
+    if (pthread_create(&tracer.flusher, NULL, trace_flusher, NULL) != 0) {
+        perror("Error starting trace thread");
+        exit(EXIT_FAILURE);
+    }
+    atexit(stop_trace); // Also finishes the trace of runs that stop with an error
+}
+
+// Function to stop tracing: writes out the remaining events, a CountsRecord holding the number of
+// threads, and how often every instruction ran and the clock ticks spent in it if it does I/O, on
+// all threads together,
+// and an EndRecord holding the clock ticks and nanoseconds the trace took, from which the summary
+// converts ticks to time. A thread timed the first of every TRACE_IO_SAMPLE runs of an I/O
+// instruction, so its ticks are scaled up to all of its runs.
+void stop_trace(void) {
+    atomic_store_explicit(&tracer.stop, true, memory_order_release);
+    pthread_join(tracer.flusher, NULL);
+    flush_trace_buffers();
+
+    int count = atomic_load_explicit(&tracer.buffer_count, memory_order_acquire);
+    unsigned char record[32];
+    unsigned char* out = record;
+    *out++ = CountsRecord;
+    out = put_varint(out, count);
+    out = put_varint(out, tracer.instruction_count);
+    fwrite(record, 1, out - record, tracer.file);
+    for (int i = 0; i < tracer.instruction_count; i++) {
+        unsigned long long total = 0;
+        unsigned long long ticks = 0;
+        for (int b = 0; b < count; b++) {
+            unsigned long long runs = tracer.buffers[b]->counts[i];
+            unsigned long long timed = (runs + TRACE_IO_SAMPLE - 1) / TRACE_IO_SAMPLE;
+            unsigned long long io_ticks = tracer.buffers[b]->io_ticks[i];
+            total += runs;
+            if (io_ticks > timed * tracer.clock_cost) {
+                ticks += (unsigned long long)((double)(io_ticks - timed * tracer.clock_cost) * runs / timed);
+            }
+        }
+        out = put_varint(record, total);
+        out = put_varint(out, ticks);
+        fwrite(record, 1, out - record, tracer.file);
+    }
+
+    out = record;
+    *out++ = EndRecord;
+    out = put_varint(out, trace_clock() - tracer.start_clock);
+    out = put_varint(out, monotonic_nanoseconds() - tracer.start_time);
+    fwrite(record, 1, out - record, tracer.file);
+    fclose(tracer.file);
+
+    for (int i = 0; i < count; i++) {
+        free(tracer.buffers[i]->counts);
+        free(tracer.buffers[i]->io_ticks);
+        free(tracer.buffers[i]);
+    }
+}
+
+// Instruction dispatch: GCC and Clang thread the handlers together with computed goto, so every
+// handler ends in its own indirect jump; other compilers, or builds with STAR_SWITCH_DISPATCH
+// defined, use a portable switch loop.
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(STAR_SWITCH_DISPATCH)
+#define STAR_COMPUTED_GOTO 1
+#define HANDLER(op) label_##op:
+#define NEXT() goto *dispatch[code[pc].op]
+#else
+#define HANDLER(op) case op:
+#define NEXT() continue
+#endif
+
+// Traced runs time one in TRACE_IO_SAMPLE runs of every I/O instruction, as reading the clock
+// costs about as much as a short write; untraced ones only test trace
+#define IO_BEGIN() \
+    bool io_timed = trace != NULL && (trace_counts[pc] - 1) % TRACE_IO_SAMPLE == 0; \
+    unsigned long long io_start = io_timed ? trace_clock() : 0
+#define IO_END() if (io_timed) trace_io_ticks[pc] += trace_clock() - io_start
+
+// Function to execute a compiled program
+void run_program(const Program* program, Machine* machine) {
+    const Instruction* code = program->code;
+    Variable* vars = machine->vars;
+    int loop_counters[MAX_LOOP_DEPTH];
+    int depth = machine->depth;
+    int pc = machine->pc;
+    memcpy(loop_counters, machine->loop_counters, depth * sizeof(int));
+    TraceBuffer* trace = tracer.file != NULL ? get_trace_buffer() : NULL;
+    unsigned long long* trace_counts = NULL;
+    unsigned long long* trace_io_ticks = NULL;
+    if (trace != NULL) {
+        trace_counts = trace->counts + program->origin;
+        trace_io_ticks = trace->io_ticks + program->origin;
+    }
+
+#ifdef STAR_COMPUTED_GOTO
+    static void* const labels[] = {
+        [OpAssign] = &&label_OpAssign,
+        [OpTextAssign] = &&label_OpTextAssign,
+        [OpTextFromInt] = &&label_OpTextFromInt,
+        [OpRead] = &&label_OpRead,
+        [OpWrite] = &&label_OpWrite,
+        [OpNewLine] = &&label_OpNewLine,
+        [OpLoop] = &&label_OpLoop,
+        [OpEndLoop] = &&label_OpEndLoop,
+        [OpNop] = &&label_OpNop,
+        [OpHalt] = &&label_OpHalt,
+        [OpAddConst] = &&label_OpAddConst,
+        [OpAddVars] = &&label_OpAddVars,
+        [OpWriteLine] = &&label_OpWriteLine,
+        [OpAddConstEndLoop] = &&label_OpAddConstEndLoop
+    };
+    // Tracing sends every instruction through label_trace first to count it, so untraced runs pay
+    // nothing. A chunk's own halt is not part of the program and is not counted.
+    static void* const traced_labels[] = {
+        [OpAssign] = &&label_trace, [OpTextAssign] = &&label_trace, [OpTextFromInt] = &&label_trace,
+        [OpRead] = &&label_trace, [OpWrite] = &&label_trace, [OpNewLine] = &&label_trace,
+        [OpLoop] = &&label_trace, [OpEndLoop] = &&label_trace, [OpNop] = &&label_trace,
+        [OpHalt] = &&label_OpHalt, [OpAddConst] = &&label_trace, [OpAddVars] = &&label_trace,
+        [OpWriteLine] = &&label_trace, [OpAddConstEndLoop] = &&label_trace
+    };
+    void* const* dispatch = trace != NULL ? traced_labels : labels;
+    NEXT();
+label_trace:
+    trace_counts[pc]++;
+    goto *labels[code[pc].op];
+#else
+    while (true) {
+    if (trace != NULL && code[pc].op != OpHalt) {
+        trace_counts[pc]++;
+    }
+    switch (code[pc].op) {
+#endif
+
+    HANDLER(OpAssign) {
+        vars[code[pc].dst].value.intValue = evaluate_integer(machine, &code[pc]);
+        pc++;
+        NEXT();
+    }
+    HANDLER(OpTextAssign) {
+        execute_text_assign(program, machine, &code[pc]);
+        pc++;
+        NEXT();
+    }
+    HANDLER(OpTextFromInt) {
+        Variable* var = &vars[code[pc].dst];
+        var->length = snprintf(var->value.strValue, MAX_STRING_LENGTH, "%d", evaluate_integer(machine, &code[pc]));
+        pc++;
+        NEXT();
+    }
+    HANDLER(OpRead) {
+        IO_BEGIN();
+        // A checkpoint is saved at the read, before or while it waits, so that a restored run reads again
+        if (checkpoint_pending && machine->abort == NULL) {
+            save_checkpoint(program, machine, pc, depth, loop_counters);
+        }
+        prompt_read(program, machine, &code[pc]);
+        while (!execute_read(machine, &code[pc])) {
+            save_checkpoint(program, machine, pc, depth, loop_counters);
+        }
+        IO_END();
+        pc++;
+        NEXT();
+    }
+    HANDLER(OpWrite) {
+        IO_BEGIN();
+        write_operand(program, machine, code[pc].a);
+        IO_END();
+        pc++;
+        NEXT();
+    }
+    HANDLER(OpNewLine) {
+        IO_BEGIN();
+        fputc('\n', machine->output);
+        IO_END();
+        pc++;
+        NEXT();
+    }
+    HANDLER(OpLoop) {
+        const Instruction* instruction = &code[pc];
+        if (trace != NULL) {
+            trace_loop_enter(trace, program, machine, pc);
+        }
+        long long remaining = instruction->a.value;
+        long long summarized = 0;
+        if (remaining > 0 && instruction->summary != NULL &&
+            apply_loop_summary(machine, instruction->summary, remaining)) {
+            summarized = remaining;
+            remaining = 0;
+        } else if (remaining > 0 && instruction->parallel != NULL && thread_count > 1 && machine->abort == NULL) {
+            // Iterations the thread pool did not run are run serially, reporting any error
+            remaining = run_parallel_loop(program, machine, pc, depth, loop_counters);
+        }
+        if (remaining <= 0) {
+            if (trace != NULL) {
+                trace_loop_exit(trace, program, machine, pc, summarized);
+            }
+            pc = instruction->target + 1;
+        } else {
+            loop_counters[depth++] = (int)remaining;
+            pc++;
+        }
+        NEXT();
+    }
+    HANDLER(OpEndLoop) {
+        if (--loop_counters[depth - 1] > 0) {
+            pc = code[pc].target + 1;
+            if (checkpoint_pending && machine->abort == NULL) {
+                save_checkpoint(program, machine, pc, depth, loop_counters);
+            }
+        } else {
+            if (trace != NULL) {
+                trace_loop_exit(trace, program, machine, code[pc].target, 0);
+            }
+            depth--;
+            pc++;
+        }
+        NEXT();
+    }
+    HANDLER(OpNop) {
+        pc++;
+        NEXT();
+    }
+    HANDLER(OpAddConst) {
+        Variable* var = &vars[code[pc].dst];
+        long long result = (long long)var->value.intValue + code[pc].a.value;
+        if (result > MAX_INTEGER_VALUE) {
+            integer_overflow(machine, var);
+        }
+        var->value.intValue = (int)result;
+        pc++;
+        NEXT();
+    }
+    HANDLER(OpAddVars) {
+        const Instruction* instruction = &code[pc];
+        Variable* var = &vars[instruction->dst];
+        long long result = (long long)vars[instruction->a.value].value.intValue +
+                           vars[instruction->b.value].value.intValue;
+        if (result > MAX_INTEGER_VALUE) {
+            integer_overflow(machine, var);
+        }
+        var->value.intValue = (int)result;
+        pc++;
+        NEXT();
+    }
+    HANDLER(OpWriteLine) {
+        IO_BEGIN();
+        write_operand(program, machine, code[pc].a);
+        fputc('\n', machine->output);
+        IO_END();
+        pc++;
+        NEXT();
+    }
+    HANDLER(OpAddConstEndLoop) {
+        const Instruction* instruction = &code[pc];
+        Variable* var = &vars[instruction->dst];
+        long long result = (long long)var->value.intValue + instruction->a.value;
+        if (result > MAX_INTEGER_VALUE) {
+            integer_overflow(machine, var);
+        }
+        var->value.intValue = (int)result;
+        if (--loop_counters[depth - 1] > 0) {
+            pc = instruction->target + 1;
+            if (checkpoint_pending && machine->abort == NULL) {
+                save_checkpoint(program, machine, pc, depth, loop_counters);
+            }
+        } else {
+            if (trace != NULL) {
+                trace_loop_exit(trace, program, machine, instruction->target, 0);
+            }
+            depth--;
+            pc++;
+        }
+        NEXT();
+    }
+    HANDLER(OpHalt) {
+        if (checkpoint_pending && machine->abort == NULL) {
+            save_checkpoint(program, machine, pc, depth, loop_counters);
+        }
+        return;
+    }
+
+#ifndef STAR_COMPUTED_GOTO
+    }
+    }
+#endif
+}
+
+#undef HANDLER
+#undef NEXT
+#undef IO_BEGIN
+#undef IO_END
+
+// Function to find a variable by name
+Variable* find_variable(const char* name) {
+    for (int i = 0; i < var_count; i++) {
+        if (strcmp(variables[i].name, name) == 0) {
+            return &variables[i];
+        }
+    }
+    return NULL;
+}
+
+// Function to declare a new variable
+void declare_variable(const char* name, enum VarType type) {
+    if (find_variable(name) != NULL) {
+        fprintf(stderr, "Semantic error: Variable already declared: %s\n", name);
+        exit(EXIT_FAILURE);
+    }
+    if (var_count >= MAX_VARIABLES) {
+        fprintf(stderr, "Semantic error: Too many variables declared\n");
+        exit(EXIT_FAILURE);
+    }
+    Variable* var = &variables[var_count++];
+    strncpy(var->name, name, MAX_IDENTIFIER_LENGTH);
+    var->name[MAX_IDENTIFIER_LENGTH] = '\0';
+    var->type = type;
+    if (type == Integer) {
+        var->value.intValue = 0;
+    } else {
+        var->value.strValue[0] = '\0';
+        var->length = 0;
+    }
+}
@@ -0,0 +1,155 @@
+// Randomized check of incremental lexing: applies seeded random edits to a token stream and
+// compares it after every edit with lex_token run over the whole edited source. Most edits that
+// leave a lexical error are undone again (and the undo checked too); one in ERROR_KEPT is kept, and
+// the next edits work on the source with the error in it. If the error is still there after
+// ERROR_EDITS edits, the whole source is replaced by the last valid one.
+//
+// Build and run from StarInterpreter/:
+//     gcc -O2 -pthread -o relexCheck tests/relexCheck.c
+//     ./relexCheck code.sta 3000 1
+#define STAR_NO_MAIN
+#include "../starInterpreter.c"
+
+#define ERROR_KEPT 4
+#define ERROR_EDITS 8
+
+// Function to check if a token stream stops at a lexical error
+bool ends_in_lexical_error(const TokenStream* stream) {
+    return stream->count >= 2 && stream_token(stream, stream->count - 2).type == LexicalError;
+}
+
+// Function to copy the whole source of a token stream into a new string
+char* copy_whole_source(const TokenStream* stream) {
+    char* source = (char*)malloc(stream->length + 1);
+    if (source == NULL) {
+        perror("Memory allocation error");
+        exit(EXIT_FAILURE);
+    }
+    copy_stream_source(stream, 0, stream->length, source);
+    source[stream->length] = '\0';
+    return source;
+}
+
+// Function to check if two tokens are the same
+bool same_token(const Token* expected, const Token* actual) {
+    return expected->type == actual->type && expected->start == actual->start && expected->end == actual->end &&
+           strcmp(expected->value, actual->value) == 0;
+}
+
+// Function to compare a token stream with lex_token run over its whole source from the start. A
+// lexical error ends the tokens, and the stream follows it with a Terminator at the end.
+bool matches_full_lex(const TokenStream* stream) {
+    char* source = copy_whole_source(stream);
+    const char* ptr = source;
+    Token expected;
+    const char* warning;
+    bool same = true;
+    int i = 0;
+    do {
+        ptr = lex_token(source, ptr, &expected, &warning);
+        if (i < stream->count) {
+            Token actual = stream_token(stream, i);
+            same = same_token(&expected, &actual);
+        } else {
+            same = false;
+        }
+        i++;
+    } while (same && expected.type != Terminator && expected.type != LexicalError);
+    free(source);
+
+    if (same && expected.type == LexicalError) {
+        if (i < stream->count) {
+            Token actual = stream_token(stream, i);
+            same = actual.type == Terminator && actual.start == stream->length && actual.end == stream->length;
+        } else {
+            same = false;
+        }
+        i++;
+    }
+    return same && i == stream->count;
+}
+
+// Function to apply an edit to a token stream and check it, exiting on a mismatch
+void checked_edit(TokenStream* stream, int n, int offset, int removed_length, const char* inserted, const char* what) {
+    edit_token_stream(stream, offset, removed_length, inserted);
+    if (!matches_full_lex(stream)) {
+        fprintf(stderr, "Relex check failed at %s %d: offset %d, removed %d, inserted \"%.40s\"\n",
+                what, n, offset, removed_length, inserted);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    static const char* fragments[] = {
+        " ", "\n", ".", ",", "\"", "/*", "*/", "/", "*", "+", "-", "{", "}", "_", "7", "42", "-5",
+        "123456789", "x", "ab", "is", "int", "text", "loop", "times", "write", "newLine", "\"hi\"",
+        "abcdefghijk"
+    };
+    int fragment_count = sizeof(fragments) / sizeof(fragments[0]);
+    if (argc < 3 || atoi(argv[2]) < 1) {
+        fprintf(stderr, "Usage: %s file.sta EDITS [SEED]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    int edits = atoi(argv[2]);
+    unsigned seed = argc > 3 ? (unsigned)strtoul(argv[3], NULL, 10) : 1;
+    srand(seed);
+
+    char* source_code = read_source_code(argv[1]);
+    TokenStream stream;
+    init_token_stream(&stream, source_code);
+    if (ends_in_lexical_error(&stream)) {
+        fprintf(stderr, "Error: %s does not lex without errors\n", argv[1]);
+        exit(EXIT_FAILURE);
+    }
+
+    int undone = 0;
+    int kept = 0;
+    int restored = 0;
+    char* valid_source = NULL; // while an error is kept, the source before it
+    int error_edits = 0;
+    long long tokens = 0;
+    for (int n = 1; n <= edits; n++) {
+        int offset = rand() % (stream.length + 1);
+        int removed_length = rand() % (stream.length - offset < 5 ? stream.length - offset + 1 : 5);
+        char inserted[64] = "";
+        for (int pieces = rand() % 3; pieces > 0; pieces--) {
+            strcat(inserted, fragments[rand() % fragment_count]);
+        }
+        char removed[8];
+        copy_stream_source(&stream, offset, removed_length, removed);
+        removed[removed_length] = '\0';
+
+        checked_edit(&stream, n, offset, removed_length, inserted, "edit");
+        if (valid_source != NULL) {
+            // An error was kept: edit on until it is gone, or put the valid source back
+            if (!ends_in_lexical_error(&stream)) {
+                free(valid_source);
+                valid_source = NULL;
+            } else if (++error_edits == ERROR_EDITS) {
+                checked_edit(&stream, n, 0, stream.length, valid_source, "restore after edit");
+                free(valid_source);
+                valid_source = NULL;
+                restored++;
+            }
+        } else if (ends_in_lexical_error(&stream)) {
+            checked_edit(&stream, n, offset, (int)strlen(inserted), removed, "undo of edit");
+            if (rand() % ERROR_KEPT == 0) {
+                valid_source = copy_whole_source(&stream);
+                checked_edit(&stream, n, offset, removed_length, inserted, "redo of edit");
+                error_edits = 0;
+                kept++;
+            } else {
+                undone++;
+            }
+        }
+        tokens += stream.count;
+    }
+
+    printf("Relex check passed with seed %u: %d edits matched a full lex (%d left an error that was kept, "
+           "%d undone, %d restores of a valid source), %lld tokens on average\n",
+           seed, edits, kept, undone, restored, tokens / edits);
+    free(valid_source);
+    free_token_stream(&stream);
+    arena_free(&arena);
+    return 0;
+}
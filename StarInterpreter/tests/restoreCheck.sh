@@ -0,0 +1,148 @@
+#!/bin/sh
+# Checks checkpoints end to end: a run stopped with SIGTERM at several points (serially, in a
+# parallel loop, twice in a row, and while it waits to write to a full pipe) and then restored
+# must print exactly the output of an uninterrupted run, and a SIGINT must stop a run that waits
+# in a read. A run that finishes before it is stopped counts as a failure.
+#
+# Run from StarInterpreter/:
+#     sh tests/restoreCheck.sh
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+star="$dir/starInterpreter"
+gcc -O2 -pthread -o "$star" starInterpreter.c || exit 1
+failures=0
+stops=0
+
+# A text loop, a parallel loop that writes, then a loop the optimizer can neither fold nor split
+cat > "$dir/job.sta" <<'EOF'
+text line, word.
+int i, a, b, x.
+word is "ab".
+loop 60000 times {
+    line is "".
+    loop 40 times line is line + word.
+    loop 39 times line is line - word.
+    write i, " ", line, newLine.
+    i is i + 1.
+}
+i is 0.
+loop 2000000 times {
+    write "line ", i, newLine.
+    i is i + 1.
+}
+i is 0.
+loop 3000 times {
+    a is 0.
+    b is i + 1.
+    loop 10000 times {
+        x is a + b.
+        a is x - b.
+        a is a + 1.
+    }
+    write i, " ", a, newLine.
+    i is i + 1.
+}
+EOF
+
+# Function to run the job with --checkpoint and stop it with SIGTERM after a delay; appends the
+# output to part.txt, through a pipe that is only read after a second when $4 is "slow". Returns
+# whether a snapshot was saved, and counts a run that finished before the stop as a failure.
+stop_after() {
+    rm -f "$dir/job.snap" "$dir/output"
+    output="$dir/part.txt"
+    reader=
+    if test "$4" = slow; then
+        output="$dir/output"
+        mkfifo "$output"
+        (sleep 1; cat) < "$output" >> "$dir/part.txt" &
+        reader=$!
+    fi
+    "$star" --threads "$1" --checkpoint "$dir/job.snap" $3 "$dir/job.sta" >> "$output" 2> "$dir/err.txt" &
+    pid=$!
+    sleep "$2"
+    kill -TERM $pid 2> /dev/null
+    wait $pid
+    test -n "$reader" && wait $reader
+    if test -f "$dir/job.snap"; then
+        stops=$((stops + 1))
+        return 0
+    fi
+    echo "FAILED: the run finished before SIGTERM after ${2}s"
+    failures=$((failures + 1))
+    return 1
+}
+
+# Function to compare part.txt with the output of the uninterrupted run
+check_output() {
+    if cmp -s "$dir/full.txt" "$dir/part.txt"; then
+        echo "ok: $1"
+    else
+        echo "FAILED: $1"
+        failures=$((failures + 1))
+    fi
+}
+
+# Function to print a share of the uninterrupted run time in seconds
+share_of_run() {
+    awk "BEGIN { printf \"%.3f\", $run_time * $1 / 1000000000 }"
+}
+
+"$star" --threads 1 "$dir/job.sta" > "$dir/full.txt"
+for threads in 1 4; do
+    # Stops are spread over the run, whatever the speed of the machine
+    start=$(date +%s%N)
+    "$star" --threads $threads "$dir/job.sta" > /dev/null
+    run_time=$(($(date +%s%N) - start))
+    for fraction in 0.05 0.2 0.4 0.6 0.75; do
+        delay=$(share_of_run $fraction)
+        rm -f "$dir/part.txt"
+        if stop_after $threads $delay; then
+            "$star" --threads $threads --restore "$dir/job.snap" "$dir/job.sta" >> "$dir/part.txt"
+            check_output "$threads thread(s), SIGTERM after ${delay}s"
+        fi
+    done
+
+    # Stop a restored run again and restore its own snapshot
+    rm -f "$dir/part.txt"
+    if stop_after $threads $(share_of_run 0.1) && cp "$dir/job.snap" "$dir/first.snap" &&
+       stop_after $threads $(share_of_run 0.3) "--restore $dir/first.snap"; then
+        "$star" --threads $threads --restore "$dir/job.snap" "$dir/job.sta" >> "$dir/part.txt"
+        check_output "$threads thread(s), SIGTERM twice"
+    fi
+
+    # Stop a run whose output goes to a pipe nobody reads yet, so that it waits in a write
+    rm -f "$dir/part.txt"
+    if stop_after $threads 0.3 "" slow; then
+        "$star" --threads $threads --restore "$dir/job.snap" "$dir/job.sta" >> "$dir/part.txt"
+        check_output "$threads thread(s), SIGTERM while writing to a full pipe"
+    fi
+done
+
+# A SIGINT while the program waits for input saves a snapshot at the read, which reads again
+cat > "$dir/read.sta" <<'EOF'
+int n. text s.
+read n. read s.
+loop 3 times write s, " ", n, newLine.
+EOF
+echo "3 hello" | "$star" "$dir/read.sta" > "$dir/full.txt"
+mkfifo "$dir/input"
+sleep 5 > "$dir/input" &
+writer=$!
+rm -f "$dir/job.snap"
+"$star" --checkpoint "$dir/job.snap" "$dir/read.sta" < "$dir/input" > "$dir/prompt.txt" 2> "$dir/err.txt" &
+pid=$!
+sleep 0.3
+kill -INT $pid
+wait $pid
+kill $writer 2> /dev/null
+if test -f "$dir/job.snap"; then
+    stops=$((stops + 1))
+    echo "3 hello" | "$star" --restore "$dir/job.snap" "$dir/read.sta" > "$dir/part.txt"
+    check_output "SIGINT during a read"
+else
+    echo "FAILED: SIGINT during a read saved no snapshot"
+    failures=$((failures + 1))
+fi
+echo "$stops snapshots restored, $failures failure(s)"
+test $failures -eq 0
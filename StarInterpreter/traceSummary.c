@@ -0,0 +1,576 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+
+// Define trace format constants, as written by starInterpreter --trace
+#define TRACE_MAGIC "STRC"
+#define TRACE_VERSION 3
+#define MAX_THREADS 256
+#define MAX_LOOP_DEPTH 64
+#define HOT_STATEMENTS 10
+#define STATEMENT_PREVIEW 40
+
+// Define kinds of trace events
+enum TraceEventKind {
+    LoopEnterEvent,
+    LoopExitEvent
+};
+
+// Define records of the trace file
+enum TraceRecord {
+    EventsRecord = 1,
+    EndRecord = 2,
+    CountsRecord = 3
+};
+
+// Define classes of instructions in the trace header
+enum TraceClass {
+    ComputeClass,
+    IoClass,
+    LoopClass,
+    ControlClass
+};
+
+// Per-instruction totals
+typedef struct {
+    int class;
+    int source;                     // offset of the statement in the source code, -1 if none
+    int target;                     // loops: index of the loop's end, -1 for other instructions
+    int loop;                       // innermost loop around the instruction, -1 if none
+    unsigned long long count;       // executions, from the CountsRecord
+    unsigned long long ticks;       // I/O: from the CountsRecord; others: estimated by estimate_ticks
+    unsigned long long entries;     // loops: LoopEnterEvents
+    unsigned long long iterations;  // loops: runs of the loop's end, plus iterations done in closed form
+    unsigned long long inclusive;   // loops: ticks from entry to exit, including the body
+    unsigned long long exclusive;   // loops: inclusive ticks not spent in nested loops, nor in I/O
+                                    // once estimate_ticks has run
+} InstructionStats;
+
+// Per-statement totals, summed over the instructions compiled from the statement
+typedef struct {
+    int source;
+    unsigned long long count;
+    unsigned long long ticks;
+} StatementStats;
+
+// Open loop of a thread
+typedef struct {
+    int pc;
+    unsigned long long entered;
+    unsigned long long nested;  // ticks spent in nested loops since entry
+} OpenLoop;
+
+// State of a thread while replaying its events
+typedef struct {
+    unsigned long long clock;
+    unsigned long long nested;  // ticks spent in loops outside of any loop
+    OpenLoop loops[MAX_LOOP_DEPTH];
+    int depth;
+    bool seen;
+} ThreadState;
+
+// Trace reader
+typedef struct {
+    FILE* file;
+    const char* path;
+} Reader;
+
+// Function prototypes
+void read_trace(Reader* reader);
+unsigned long long read_varint(Reader* reader);
+int read_byte(Reader* reader);
+const unsigned char* decode_varint(const unsigned char* in, const unsigned char* end, unsigned long long* value);
+void replay_events(const unsigned char* events, size_t length, ThreadState* thread);
+void close_loop(ThreadState* thread, int depth);
+bool shares_region(const InstructionStats* instruction, const bool* has_compute);
+void estimate_ticks(void);
+char* read_source(const char* filepath);
+int line_of(const char* source, int offset);
+void describe_statement(const char* source, int offset, char* out, size_t size);
+int compare_statements(const void* a, const void* b);
+double seconds(unsigned long long ticks);
+double share(unsigned long long ticks, unsigned long long total);
+void print_summary(const char* source_path);
+
+// Global trace contents
+InstructionStats* instructions = NULL;
+int instruction_count = 0;
+char* traced_source_path = NULL;
+ThreadState threads[MAX_THREADS];
+int thread_count = 0;
+unsigned long long event_count = 0;
+unsigned long long end_ticks = 0;
+unsigned long long end_nanoseconds = 0;
+bool finished = false;
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s trace-file [file.sta]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    Reader reader = {fopen(argv[1], "rb"), argv[1]};
+    if (reader.file == NULL) {
+        perror("Error opening trace file");
+        exit(EXIT_FAILURE);
+    }
+    read_trace(&reader);
+    fclose(reader.file);
+
+    print_summary(argc == 3 ? argv[2] : traced_source_path);
+    free(instructions);
+    free(traced_source_path);
+    return 0;
+}
+
+// Function to read one byte of the trace, or EOF
+int read_byte(Reader* reader) {
+    return fgetc(reader->file);
+}
+
+// Function to read an unsigned LEB128 varint from the trace
+unsigned long long read_varint(Reader* reader) {
+    unsigned long long value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = read_byte(reader);
+        if (byte == EOF) {
+            fprintf(stderr, "Error: Trace file %s is truncated\n", reader->path);
+            exit(EXIT_FAILURE);
+        }
+        value |= (unsigned long long)(byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            return value;
+        }
+    }
+    fprintf(stderr, "Error: Trace file %s is corrupt\n", reader->path);
+    exit(EXIT_FAILURE);
+}
+
+// Function to read the header and all records of a trace
+void read_trace(Reader* reader) {
+    unsigned char header[8];
+    if (fread(header, 1, 8, reader->file) != 8 || memcmp(header, TRACE_MAGIC, 4) != 0) {
+        fprintf(stderr, "Error: %s is not a STAR trace\n", reader->path);
+        exit(EXIT_FAILURE);
+    }
+    unsigned int version = header[4] | header[5] << 8 | header[6] << 16 | (unsigned int)header[7] << 24;
+    if (version != TRACE_VERSION) {
+        fprintf(stderr, "Error: Trace version %u is not supported\n", version);
+        exit(EXIT_FAILURE);
+    }
+
+    size_t path_length = read_varint(reader);
+    traced_source_path = (char*)malloc(path_length + 1);
+    if (traced_source_path == NULL || fread(traced_source_path, 1, path_length, reader->file) != path_length) {
+        fprintf(stderr, "Error: Trace file %s is truncated\n", reader->path);
+        exit(EXIT_FAILURE);
+    }
+    traced_source_path[path_length] = '\0';
+
+    instruction_count = (int)read_varint(reader);
+    instructions = (InstructionStats*)calloc(instruction_count > 0 ? instruction_count : 1, sizeof(InstructionStats));
+    if (instructions == NULL) {
+        perror("Memory allocation error");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < instruction_count; i++) {
+        instructions[i].class = read_byte(reader);
+        instructions[i].source = (int)read_varint(reader) - 1;
+        instructions[i].target = -1;
+        instructions[i].loop = -1;
+        if (instructions[i].class == LoopClass) {
+            instructions[i].target = (int)read_varint(reader);
+            if (instructions[i].target <= i || instructions[i].target >= instruction_count) {
+                fprintf(stderr, "Error: Trace file %s is corrupt\n", reader->path);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    // Loops start in order, so an inner loop overrides the outer one for its body
+    for (int i = 0; i < instruction_count; i++) {
+        for (int j = i + 1; j <= instructions[i].target; j++) {
+            instructions[j].loop = i;
+        }
+    }
+
+    unsigned char* events = NULL;
+    size_t capacity = 0;
+    int record;
+    while ((record = read_byte(reader)) != EOF) {
+        if (record == EventsRecord) {
+            size_t thread = read_varint(reader);
+            size_t length = read_varint(reader);
+            if (thread >= MAX_THREADS) {
+                fprintf(stderr, "Error: Trace file %s is corrupt\n", reader->path);
+                exit(EXIT_FAILURE);
+            }
+            if (length > capacity) {
+                capacity = length;
+                events = (unsigned char*)realloc(events, capacity);
+                if (events == NULL) {
+                    perror("Memory allocation error");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            if (fread(events, 1, length, reader->file) != length) {
+                fprintf(stderr, "Error: Trace file %s is truncated\n", reader->path);
+                exit(EXIT_FAILURE);
+            }
+            if (!threads[thread].seen) {
+                threads[thread].seen = true;
+                thread_count++;
+            }
+            replay_events(events, length, &threads[thread]);
+        } else if (record == CountsRecord) {
+            // Threads that only ran I/O and compute instructions have no events
+            size_t traced_threads = read_varint(reader);
+            if (traced_threads > MAX_THREADS || (int)read_varint(reader) != instruction_count) {
+                fprintf(stderr, "Error: Trace file %s is corrupt\n", reader->path);
+                exit(EXIT_FAILURE);
+            }
+            for (int i = 0; i < instruction_count; i++) {
+                instructions[i].count = read_varint(reader);
+                instructions[i].ticks = read_varint(reader);
+            }
+            if ((int)traced_threads > thread_count) {
+                thread_count = (int)traced_threads;
+            }
+        } else if (record == EndRecord) {
+            end_ticks = read_varint(reader);
+            end_nanoseconds = read_varint(reader);
+            finished = true;
+        } else {
+            fprintf(stderr, "Error: Trace file %s is corrupt\n", reader->path);
+            exit(EXIT_FAILURE);
+        }
+    }
+    free(events);
+
+    // Every iteration that ran ends in the loop's end instruction, on whichever thread ran it
+    for (int i = 0; i < instruction_count; i++) {
+        if (instructions[i].class == LoopClass) {
+            instructions[i].iterations += instructions[instructions[i].target].count;
+        }
+    }
+}
+
+// Function to decode an unsigned LEB128 varint from an events record
+const unsigned char* decode_varint(const unsigned char* in, const unsigned char* end, unsigned long long* value) {
+    *value = 0;
+    for (int shift = 0; in < end && shift < 64; shift += 7) {
+        unsigned char byte = *in++;
+        *value |= (unsigned long long)(byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            return in;
+        }
+    }
+    fprintf(stderr, "Error: Trace events are corrupt\n");
+    exit(EXIT_FAILURE);
+}
+
+// Function to replay the events of one record on the state of its thread. The time of a finished
+// loop is also counted as nested time of the loop around it.
+void replay_events(const unsigned char* events, size_t length, ThreadState* thread) {
+    const unsigned char* in = events;
+    const unsigned char* end = events + length;
+    while (in < end) {
+        unsigned long long word, delta, value = 0;
+        in = decode_varint(in, end, &word);
+        in = decode_varint(in, end, &delta);
+        int kind = (int)(word & 1);
+        unsigned long long pc = word >> 1;
+        if (kind == LoopExitEvent) {
+            in = decode_varint(in, end, &value);
+        }
+        if (pc >= (unsigned long long)instruction_count) {
+            fprintf(stderr, "Error: Trace events are corrupt\n");
+            exit(EXIT_FAILURE);
+        }
+        thread->clock += delta;
+        event_count++;
+
+        InstructionStats* instruction = &instructions[pc];
+        if (kind == LoopEnterEvent) {
+            instruction->entries++;
+            if (thread->depth < MAX_LOOP_DEPTH) {
+                thread->loops[thread->depth].pc = (int)pc;
+                thread->loops[thread->depth].entered = thread->clock;
+                thread->loops[thread->depth].nested = 0;
+                thread->depth++;
+            }
+        } else {
+            instruction->iterations += value;
+            int depth = thread->depth;
+            while (depth > 0 && thread->loops[depth - 1].pc != (int)pc) {
+                depth--;
+            }
+            if (depth > 0) {
+                close_loop(thread, depth);
+            } else if (thread->depth == 0) {
+                // A run restored from a checkpoint exits loops whose entry was never traced: they
+                // ran from the start of the trace
+                instruction->inclusive += thread->clock;
+                instruction->exclusive += thread->clock > thread->nested ? thread->clock - thread->nested : 0;
+                thread->nested = thread->clock;
+            }
+        }
+    }
+}
+
+// Function to close the open loop at depth - 1 of a thread, and any loop left open inside it,
+// at the thread's clock; its time counts as nested time of the loop around it
+void close_loop(ThreadState* thread, int depth) {
+    const OpenLoop* loop = &thread->loops[depth - 1];
+    InstructionStats* instruction = &instructions[loop->pc];
+    unsigned long long time = thread->clock - loop->entered;
+    instruction->inclusive += time;
+    instruction->exclusive += time > loop->nested ? time - loop->nested : 0;
+    thread->depth = depth - 1;
+    if (thread->depth > 0) {
+        thread->loops[thread->depth - 1].nested += time;
+    } else {
+        thread->nested += time;
+    }
+}
+
+// Function to check if the estimated time of a region goes to an instruction: to its compute
+// instructions, or to its loop control when it has none, since a jump costs far less than a
+// statement
+bool shares_region(const InstructionStats* instruction, const bool* has_compute) {
+    int region = instruction->loop >= 0 ? instruction->loop : instruction_count;
+    return instruction->class == ComputeClass || (instruction->class != IoClass && !has_compute[region]);
+}
+
+// Function to estimate the ticks of the instructions that are not timed themselves: the time a
+// loop spent outside of nested loops and I/O is shared out among the instructions of its own body
+// by how often they ran, and so is the time of the main thread outside of any loop. The regions
+// are the loops, with the top level last. I/O in the body of a parallel loop ran on several
+// threads at once, so its time may exceed the loop's; the loop's own time then counts as none.
+void estimate_ticks(void) {
+    unsigned long long* runs = (unsigned long long*)calloc(instruction_count + 1, sizeof(unsigned long long));
+    unsigned long long* io = (unsigned long long*)calloc(instruction_count + 1, sizeof(unsigned long long));
+    bool* has_compute = (bool*)calloc(instruction_count + 1, sizeof(bool));
+    if (runs == NULL || io == NULL || has_compute == NULL) {
+        perror("Memory allocation error");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < instruction_count; i++) {
+        if (instructions[i].class == ComputeClass && instructions[i].count > 0) {
+            has_compute[instructions[i].loop >= 0 ? instructions[i].loop : instruction_count] = true;
+        }
+    }
+    for (int i = 0; i < instruction_count; i++) {
+        int region = instructions[i].loop >= 0 ? instructions[i].loop : instruction_count;
+        if (shares_region(&instructions[i], has_compute)) {
+            runs[region] += instructions[i].count;
+        } else if (instructions[i].class == IoClass) {
+            io[region] += instructions[i].ticks;
+        }
+    }
+
+    // Loops still open when the trace ended (a checkpoint stop or a runtime error) end with it
+    if (finished && end_ticks > threads[0].clock) {
+        threads[0].clock = end_ticks;
+    }
+    for (int t = 0; t < MAX_THREADS; t++) {
+        while (threads[t].depth > 0) {
+            close_loop(&threads[t], threads[t].depth);
+        }
+    }
+    for (int i = 0; i < instruction_count; i++) {
+        if (instructions[i].class == LoopClass) {
+            unsigned long long exclusive = instructions[i].exclusive;
+            instructions[i].exclusive = exclusive > io[i] ? exclusive - io[i] : 0;
+        }
+    }
+    unsigned long long top_level = threads[0].clock > threads[0].nested ? threads[0].clock - threads[0].nested : 0;
+    top_level = top_level > io[instruction_count] ? top_level - io[instruction_count] : 0;
+    for (int i = 0; i < instruction_count; i++) {
+        InstructionStats* instruction = &instructions[i];
+        if (!shares_region(instruction, has_compute) || instruction->count == 0) {
+            continue;
+        }
+        int region = instruction->loop >= 0 ? instruction->loop : instruction_count;
+        unsigned long long ticks = instruction->loop >= 0 ? instructions[instruction->loop].exclusive : top_level;
+        instruction->ticks = (unsigned long long)((double)ticks * instruction->count / runs[region]);
+    }
+    // Nothing in the body of a loop done in closed form ran, so its time goes to the loop itself
+    for (int i = 0; i < instruction_count; i++) {
+        if (instructions[i].class == LoopClass && runs[i] == 0) {
+            instructions[i].ticks += instructions[i].exclusive;
+        }
+    }
+    free(runs);
+    free(io);
+    free(has_compute);
+}
+
+// Function to read the traced program's source, or NULL if it is not available
+char* read_source(const char* filepath) {
+    FILE* file = fopen(filepath, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* source = (char*)malloc(size + 1);
+    if (source == NULL || fread(source, 1, size, file) != (size_t)size) {
+        free(source);
+        fclose(file);
+        return NULL;
+    }
+    source[size] = '\0';
+    fclose(file);
+    return source;
+}
+
+// Function to get the line number of an offset in the source code
+int line_of(const char* source, int offset) {
+    int line = 1;
+    for (int i = 0; i < offset && source[i] != '\0'; i++) {
+        if (source[i] == '\n') {
+            line++;
+        }
+    }
+    return line;
+}
+
+// Function to copy the start of the statement at offset, up to its end of line or block, on one line
+void describe_statement(const char* source, int offset, char* out, size_t size) {
+    size_t length = 0;
+    bool space = false;
+    for (const char* c = source + offset; *c != '\0' && *c != '.' && *c != '{' && length + 5 < size; c++) {
+        if (isspace((unsigned char)*c)) {
+            space = length > 0;
+            continue;
+        }
+        if (space) {
+            out[length++] = ' ';
+            space = false;
+        }
+        out[length++] = *c;
+    }
+    if (length + 5 >= size) {
+        memcpy(out + length, "...", 3);
+        length += 3;
+    }
+    out[length] = '\0';
+}
+
+// Function to order statements by descending time
+int compare_statements(const void* a, const void* b) {
+    const StatementStats* left = (const StatementStats*)a;
+    const StatementStats* right = (const StatementStats*)b;
+    if (left->ticks != right->ticks) {
+        return left->ticks < right->ticks ? 1 : -1;
+    }
+    return left->source - right->source;
+}
+
+// Function to convert clock ticks to seconds
+double seconds(unsigned long long ticks) {
+    return end_ticks > 0 ? (double)ticks * end_nanoseconds / end_ticks / 1e9 : 0.0;
+}
+
+// Function to compute a percentage of the traced time
+double share(unsigned long long ticks, unsigned long long total) {
+    return total > 0 ? 100.0 * ticks / total : 0.0;
+}
+
+// Function to print the summary of the trace
+void print_summary(const char* source_path) {
+    char* source = read_source(source_path);
+    if (source == NULL) {
+        fprintf(stderr, "Warning: Cannot read %s, statements are shown by offset\n", source_path);
+    }
+    if (!finished) {
+        fprintf(stderr, "Warning: The trace has no end record, times are not available\n");
+    }
+
+    estimate_ticks();
+    unsigned long long class_ticks[ControlClass + 1] = {0};
+    unsigned long long total = 0;
+    unsigned long long runs = 0;
+    for (int i = 0; i < instruction_count; i++) {
+        if (instructions[i].class >= ComputeClass && instructions[i].class <= ControlClass) {
+            class_ticks[instructions[i].class] += instructions[i].ticks;
+        }
+        total += instructions[i].ticks;
+        runs += instructions[i].count;
+    }
+
+    printf("Trace of %s: %llu instructions run, %llu events from %d thread%s, %.3f s traced, %.3f s elapsed\n",
+           traced_source_path, runs, event_count, thread_count, thread_count == 1 ? "" : "s", seconds(total),
+           end_nanoseconds / 1e9);
+    printf("Time: compute %.1f%%, I/O %.1f%%\n\n", share(total - class_ticks[IoClass], total),
+           share(class_ticks[IoClass], total));
+
+    // Instructions compiled from the same statement share its offset
+    StatementStats* statements = (StatementStats*)calloc(instruction_count > 0 ? instruction_count : 1, sizeof(StatementStats));
+    if (statements == NULL) {
+        perror("Memory allocation error");
+        exit(EXIT_FAILURE);
+    }
+    int statement_count = 0;
+    for (int i = 0; i < instruction_count; i++) {
+        const InstructionStats* instruction = &instructions[i];
+        bool closed_form = instruction->class == LoopClass && instructions[instruction->target].count == 0;
+        if ((instruction->class != ComputeClass && instruction->class != IoClass && !closed_form) ||
+            instruction->source < 0 || instruction->count == 0) {
+            continue;
+        }
+        int s = 0;
+        while (s < statement_count && statements[s].source != instruction->source) {
+            s++;
+        }
+        if (s == statement_count) {
+            statements[statement_count++].source = instruction->source;
+        }
+        if (instruction->count > statements[s].count) {
+            statements[s].count = instruction->count;
+        }
+        statements[s].ticks += instruction->ticks;
+    }
+    qsort(statements, statement_count, sizeof(StatementStats), compare_statements);
+
+    char text[STATEMENT_PREVIEW + 1];
+    printf("Hot statements:\n");
+    printf("%10s %7s %14s %6s  %s\n", "time", "share", "runs", "line", "statement");
+    for (int s = 0; s < statement_count && s < HOT_STATEMENTS; s++) {
+        if (source != NULL) {
+            describe_statement(source, statements[s].source, text, sizeof(text));
+            printf("%8.3f s %6.1f%% %14llu %6d  %s\n", seconds(statements[s].ticks), share(statements[s].ticks, total),
+                   statements[s].count, line_of(source, statements[s].source), text);
+        } else {
+            printf("%8.3f s %6.1f%% %14llu %6s  offset %d\n", seconds(statements[s].ticks),
+                   share(statements[s].ticks, total), statements[s].count, "?", statements[s].source);
+        }
+    }
+    free(statements);
+
+    printf("\nLoops:\n");
+    printf("%6s %12s %14s %14s %10s %7s\n", "line", "entries", "iterations", "trips/entry", "time", "share");
+    for (int i = 0; i < instruction_count; i++) {
+        const InstructionStats* loop = &instructions[i];
+        if (loop->class != LoopClass || (loop->entries == 0 && loop->iterations == 0)) {
+            continue;
+        }
+        char line[16];
+        if (source != NULL && loop->source >= 0) {
+            snprintf(line, sizeof(line), "%d", line_of(source, loop->source));
+        } else {
+            snprintf(line, sizeof(line), "@%d", loop->source);
+        }
+        // A run restored inside a loop did not see it start
+        char trips[32] = "-";
+        if (loop->entries > 0) {
+            snprintf(trips, sizeof(trips), "%.1f", (double)loop->iterations / loop->entries);
+        }
+        printf("%6s %12llu %14llu %14s %8.3f s %6.1f%%\n", line, loop->entries, loop->iterations, trips,
+               seconds(loop->inclusive), share(loop->inclusive, total));
+    }
+    free(source);
+}